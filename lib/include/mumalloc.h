@@ -0,0 +1,48 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef MUMALLOC_H
+#define MUMALLOC_H
+
+#include <stddef.h>
+
+#define MUM_ALLOC_ALIGNMENT 64
+#define MUM_HUGE_PAGE_SIZE  (2 * 1024 * 1024)
+
+// Memory for key tables and the larger work buffers, 64-byte aligned, from
+// the heap. Not zeroed.
+void *MumAlloc(size_t size);
+// As MumAlloc, for the position tables, which the round kernels gather from:
+// with huge pages on, one of a huge page or more comes from huge pages when
+// the system has them reserved, else from transparent huge pages on a huge
+// page aligned mapping, which cuts the TLB misses of the gathers.
+void *MumAllocHugePages(size_t size);
+// frees memory from either
+void MumFree(void *ptr);
+
+// Off until enabled, in a USE_HUGEPAGES build only; applies to later
+// allocations
+void MumAllocSetHugePages(bool enable);
+
+#endif
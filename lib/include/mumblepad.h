@@ -27,20 +27,28 @@
 #define __MUMBLEPAD_H
 
 #include "mumrenderer.h"
+#include "mumcpukernel.h"
 
 class CMumblepad : public CMumRenderer {
 public:
     CMumblepad(TMumInfo *mumInfo);
     ~CMumblepad();
-    virtual void EncryptDiffuse(uint32_t round);
-    virtual void EncryptConfuse(uint32_t round);
-    virtual void DecryptConfuse(uint32_t round);
-    virtual void DecryptDiffuse(uint32_t round);
-    virtual void EncryptUpload(uint8_t *data);
-    virtual void EncryptDownload(uint8_t *data);
-    virtual void DecryptUpload(uint8_t *data);
-    virtual void DecryptDownload(uint8_t *data);
+    virtual void EncryptDiffuse(uint32_t round) { mKernel.EncryptDiffuse(round); }
+    virtual void EncryptConfuse(uint32_t round) { mKernel.EncryptConfuse(round); }
+    virtual void DecryptConfuse(uint32_t round) { mKernel.DecryptConfuse(round); }
+    virtual void DecryptDiffuse(uint32_t round) { mKernel.DecryptDiffuse(round); }
+    virtual void EncryptUpload(uint8_t *data) { mKernel.Upload(data); }
+    virtual void EncryptDownload(uint8_t *data) { mKernel.Download(data); }
+    virtual void DecryptUpload(uint8_t *data) { mKernel.Upload(data); }
+    virtual void DecryptDownload(uint8_t *data) { mKernel.Download(data); }
     virtual void InitKey();
+    virtual void EncryptRounds(uint8_t *src, uint8_t *dst) { mKernel.EncryptBlocks(src, 0, dst, 0, 1); }
+    virtual void DecryptRounds(uint8_t *src, uint8_t *dst) { mKernel.DecryptBlocks(src, 0, dst, 0, 1); }
+    virtual uint32_t BatchSize() { return mKernel.BatchSize(); }
+    virtual void EncryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride);
+    virtual void DecryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride);
+protected:
+    CMumCpuKernel mKernel;
 };
 
 
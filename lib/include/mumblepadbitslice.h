@@ -0,0 +1,56 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __MUMBLEPADBITSLICE_H
+#define __MUMBLEPADBITSLICE_H
+
+#include "mumblepad.h"
+
+// Bitsliced CPU renderer for MUM_ENGINE_TYPE_CPU_BITSLICE. A batch of
+// MUM_BITSLICE_BLOCKS blocks is held as bit planes: word [byte * 8 + bit]
+// holds that bit of that byte for every block, block j in bit j. The masks
+// of the diffuse pass keep each bit at its bit position, so diffuse is a
+// copy of one word per output bit. The substitution tables are key
+// dependent and have no compact gate network, so confuse transposes each
+// byte position back to bytes for the table lookup. Blocks that do not
+// fill a batch run through the scalar CMumblepad kernels.
+class CMumblepadBitslice : public CMumblepad {
+public:
+    CMumblepadBitslice(TMumInfo *mumInfo);
+    ~CMumblepadBitslice();
+    virtual uint32_t BatchSize() { return MUM_BITSLICE_BLOCKS; }
+    virtual void EncryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride);
+    virtual void DecryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride);
+private:
+    uint64_t *mPlanes[2];
+
+    void SliceIn(uint8_t *src, uint32_t srcStride, uint64_t *planes);
+    void SliceOut(uint64_t *planes, uint8_t *dst, uint32_t dstStride);
+    void DiffusePlanes(TMumRoundSchedule *schedule, uint16_t *gather, const uint8_t sourceBytes[MUM_NUM_POSITIONS][MUM_CELL_SIZE], uint64_t *src, uint64_t *dst);
+    void EncryptConfusePlanes(TMumRoundSchedule *schedule, uint64_t *planes);
+    void DecryptConfusePlanes(TMumRoundSchedule *schedule, uint64_t *planes);
+};
+
+
+#endif
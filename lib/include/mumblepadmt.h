@@ -26,6 +26,7 @@
 #define __MUMBLEPADMT_H
 
 #include "mumblepadthread.h"
+#include <pthread.h>
 
 #define MUM_MAX_THREADS 16
 #define MUM_MAX_BYTES_PER_JOB (16*MUM_MAX_BLOCK_SIZE)
@@ -43,6 +44,7 @@ public:
     virtual EMumError DecryptBlock(uint8_t *src, uint8_t *dst, uint32_t *length, uint32_t *seqnum);
     virtual EMumError Encrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum);
     virtual EMumError Decrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength);
+    virtual void RunParallel(TMumParallelTask task, void *param);
 
     virtual void EncryptDiffuse(uint32_t round) {}
     virtual void EncryptConfuse(uint32_t round) {}
@@ -52,12 +54,20 @@ public:
     virtual void EncryptDownload(uint8_t *data) {}
     virtual void DecryptUpload(uint8_t *data) {}
     virtual void DecryptDownload(uint8_t *data) {}
-    virtual void InitKey() {}
+    virtual void InitKey();
+    virtual void PublishInfo();
 private:
     uint32_t mNumThreads;
     CMumblepadThread *mThreads[MUM_MAX_THREADS];
     CSignal * mServerSignal;
     bool mStarted;
+    // The engine's mMumInfo, where the next key is set up, and the copy of
+    // it the workers read. InitKey and PublishInfo replace the copy between
+    // jobs: a call to Encrypt or Decrypt runs under one key throughout.
+    TMumInfo *mEngineInfo;
+    TMumInfo mLiveInfo;
+    // held by each job, and to replace mLiveInfo
+    pthread_mutex_t mJobMutex;
 
 };
 
@@ -26,6 +26,7 @@
 #define __MUMBLEPADTHREAD_H
 
 #include "mumrenderer.h"
+#include "mumcpukernel.h"
 #include <thread>
 #include "signal.h"
 
@@ -40,11 +41,12 @@ typedef enum EMumJobState {
 typedef enum EMumJobType {
     MUM_JOB_TYPE_ENCRYPT = 0,
     MUM_JOB_TYPE_DECRYPT = 1,
+    MUM_JOB_TYPE_TASK = 2,
 } EMumJobType;
 
 typedef struct TMumJob
 {
-    EMumJobState state;
+    volatile EMumJobState state;
     EMumJobType type;
     int id;
     uint8_t *src;
@@ -52,6 +54,11 @@ typedef struct TMumJob
     uint32_t length;
     uint32_t outlength;
     uint16_t seqNum;
+    // MUM_JOB_TYPE_TASK
+    TMumParallelTask task;
+    void *param;
+    uint32_t part;
+    uint32_t numParts;
 } TMumRenderJob;
 
 
@@ -59,16 +66,21 @@ class CMumblepadThread : public CMumRenderer {
 public:
     CMumblepadThread(TMumInfo *mumInfo, uint32_t id, CSignal * serverSignal);
     ~CMumblepadThread();
-    virtual void EncryptDiffuse(uint32_t round);
-    virtual void EncryptConfuse(uint32_t round);
-    virtual void DecryptConfuse(uint32_t round);
-    virtual void DecryptDiffuse(uint32_t round);
-    virtual void EncryptUpload(uint8_t *data);
-    virtual void EncryptDownload(uint8_t *data);
-    virtual void DecryptUpload(uint8_t *data);
-    virtual void DecryptDownload(uint8_t *data);
+    virtual void EncryptDiffuse(uint32_t round) { mKernel.EncryptDiffuse(round); }
+    virtual void EncryptConfuse(uint32_t round) { mKernel.EncryptConfuse(round); }
+    virtual void DecryptConfuse(uint32_t round) { mKernel.DecryptConfuse(round); }
+    virtual void DecryptDiffuse(uint32_t round) { mKernel.DecryptDiffuse(round); }
+    virtual void EncryptUpload(uint8_t *data) { mKernel.Upload(data); }
+    virtual void EncryptDownload(uint8_t *data) { mKernel.Download(data); }
+    virtual void DecryptUpload(uint8_t *data) { mKernel.Upload(data); }
+    virtual void DecryptDownload(uint8_t *data) { mKernel.Download(data); }
     virtual void InitKey();
-    uint8_t mPingPongBlock[2][MUM_MAX_BLOCK_SIZE];
+    virtual void EncryptRounds(uint8_t *src, uint8_t *dst) { mKernel.EncryptBlocks(src, 0, dst, 0, 1); }
+    virtual void DecryptRounds(uint8_t *src, uint8_t *dst) { mKernel.DecryptBlocks(src, 0, dst, 0, 1); }
+    virtual uint32_t BatchSize() { return mKernel.BatchSize(); }
+    virtual void EncryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride);
+    virtual void DecryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride);
+    CMumCpuKernel mKernel;
     uint32_t mId;
     TMumJob mJob;
     std::thread * mThreadHandle;
@@ -0,0 +1,47 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef MUMCONTEXT_H
+#define MUMCONTEXT_H
+
+#include "mumblepad.h"
+
+// Per-thread state of the reentrant API, see MumCreateContext: a CPU
+// renderer over the TMumInfo of an engine, which it only reads. The packed
+// block, padding, scratch blocks and PRNG are its own, so any number of
+// contexts of one engine encrypt and decrypt concurrently without locks.
+// Context id seeds its PRNG from one of the 16 subkey sets of the renderer
+// and the CPU-MT threads, with the full id as its stream: no two contexts
+// share a padding stream, nor any context one of the renderers.
+class CMumContext : public CMumblepad {
+public:
+    CMumContext(TMumInfo *mumInfo, uint32_t id);
+    virtual void InitKey();
+    EMumError Encrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum);
+    EMumError Decrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength);
+private:
+    uint32_t mId;
+};
+
+#endif
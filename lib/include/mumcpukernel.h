@@ -0,0 +1,62 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef MUMCPUKERNEL_H
+#define MUMCPUKERNEL_H
+
+#include "mumdefines.h"
+#include "mumalloc.h"
+
+// Sets mumInfo->cpuKernels from the kernel type and mode, the scalar
+// kernels for numRows and the JIT code, if any. Called by the engine
+// whenever one of those changes; the renderers only call through the table.
+void MumSelectCpuKernels(TMumInfo *mumInfo);
+
+// The CPU kernels shared by CMumblepad, CMumblepadThread and the bitslice
+// renderer: the scratch blocks of one renderer and non-virtual entry points
+// over the kernel table. Blocks are read from src and written to dst at the
+// strides; src may be dst.
+class CMumCpuKernel {
+public:
+    CMumCpuKernel(TMumInfo *mumInfo);
+
+    uint32_t BatchSize() { return mMumInfo->cpuKernels.batchSize; }
+    void EncryptBlocks(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride, uint32_t numBlocks);
+    void DecryptBlocks(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride, uint32_t numBlocks);
+
+    // single passes over the ping-pong blocks, for the CMumRenderer interface
+    void Upload(uint8_t *data);
+    void Download(uint8_t *data);
+    void EncryptDiffuse(uint32_t round);
+    void EncryptConfuse(uint32_t round);
+    void DecryptConfuse(uint32_t round);
+    void DecryptDiffuse(uint32_t round);
+
+private:
+    TMumInfo *mMumInfo;
+    alignas(MUM_ALLOC_ALIGNMENT) uint8_t mPingPongBlock[2][MUM_MAX_BLOCK_SIZE];
+    alignas(MUM_ALLOC_ALIGNMENT) uint8_t mBatchWork[2][MUM_BATCH_BLOCKS * MUM_MAX_BLOCK_SIZE];
+};
+
+#endif
@@ -87,6 +87,14 @@
 #define MUM_CELLS_YB        256
 #define MUM_CELL_SIZE       4
 #define MUM_NUM_POSITIONS   4
+// blocks per batch for MUM_KERNEL_MODE_BATCH
+#define MUM_BATCH_BLOCKS    16
+// blocks per batch for MUM_ENGINE_TYPE_CPU_BITSLICE, one per bit of a uint64_t
+#define MUM_BITSLICE_BLOCKS 64
+// MUM_SCHEDULE_TYPE_AUTO picks position tables when those of one round and
+// direction fit in half of a 32KB L1 data cache; each round reads its own,
+// so larger ones miss where the 256-byte row tables do not
+#define MUM_POSITION_TABLES_MAX_SIZE (16 * 1024)
 // padding is 4096-4000-8
 // #define MUM_PADDING_SIZE    88
 
@@ -198,20 +206,71 @@ typedef struct TMumBlockR1
     uint8_t paddingD[2];
 } TMumBlockR1;
 
-typedef struct TMumInfo 
+// Everything a CPU kernel reads for one round, derived from the key tables
+// at InitKey and stored contiguously so that it stays in cache: the encrypt
+// fields are 20KB for a 4096-byte block. Gather entries are the byte offset
+// of the source cell, one per position. The permutation rows are 16 slices
+// of 16 entries, a slice selected by the high nibble of the index and the
+// entry by the low nibble, for the pshufb confuse kernels.
+typedef struct TMumRoundSchedule
 {
-    EMumEngineType engineType;
-    EMumBlockType blockType;
-    bool paddingOn;
-    bool keyInitialized;
-    uint32_t numRows;
-    uint32_t plaintextBlockSize;
-    uint32_t encryptedBlockSize;
-    uint32_t paddingSize;
-    uint32_t numRoundsPerBlock;
+    uint8_t bitmasks[MUM_NUM_POSITIONS];
+    uint8_t subkey[MUM_MAX_BLOCK_SIZE];
+    uint16_t gather[MUM_CELLS_MAX_Y * MUM_CELLS_X][MUM_NUM_POSITIONS];
+    uint8_t permute[MUM_CELLS_MAX_Y][MUM_NUM_8BIT_VALUES];
+    uint16_t gatherI[MUM_CELLS_MAX_Y * MUM_CELLS_X][MUM_NUM_POSITIONS];
+    uint8_t permuteI[MUM_CELLS_MAX_Y][MUM_NUM_8BIT_VALUES];
+} TMumRoundSchedule;
+
+// all rounds of one block, src to dst, with two scratch blocks
+typedef void (*TMumBlockKernel)(struct TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1);
+// one diffuse or confuse pass of one round, src to dst
+typedef void (*TMumRoundKernel)(struct TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+// all rounds of batchSize blocks, read and written at the strides
+typedef void (*TMumBatchKernel)(struct TMumInfo *mumInfo, uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride,
+                                uint8_t *work0, uint8_t *work1);
+
+// The CPU kernels for the current kernel type, mode and key, chosen once by
+// MumSelectCpuKernels rather than on every block; see mumcpukernel.h.
+// batchSize is 1 when there is no batch kernel.
+typedef struct TMumCpuKernels
+{
+    TMumRoundKernel encryptDiffuse;
+    TMumRoundKernel encryptConfuse;
+    TMumRoundKernel decryptConfuse;
+    TMumRoundKernel decryptDiffuse;
+    TMumBlockKernel encryptBlock;
+    TMumBlockKernel decryptBlock;
+    TMumBatchKernel encryptBatch;
+    TMumBatchKernel decryptBatch;
+    uint32_t batchSize;
+} TMumCpuKernels;
 
+// precomputed tables of the GPU renderers, 8-bit unsigned; see
+// CMumRenderer::CreateTextureData
+typedef struct TMumTextureData
+{
+    uint8_t bitmaskTextureData[MUM_NUM_ROUNDS][MUM_MASK_TABLE_ROWS*MUM_NUM_8BIT_VALUES];
+    uint8_t permuteTextureData[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_NUM_8BIT_VALUES];
+    uint8_t permuteTextureDataI[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_NUM_8BIT_VALUES];
+    uint8_t positionTextureDataX[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
+    uint8_t positionTextureDataY[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
+    uint8_t positionTextureDataYB[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
+    uint8_t positionTextureDataXI[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
+    uint8_t positionTextureDataYI[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
+    uint8_t positionTextureDataYIB[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
+    uint8_t xorTextureData[MUM_NUM_8BIT_VALUES*MUM_NUM_8BIT_VALUES];
+} TMumTextureData;
+
+// Everything derived from the key for one block type. It holds no pointers,
+// so a copy works at any address: in an engine, in the key cache, in a
+// schedule file or in a shared memory segment.
+typedef struct TMumKeyTables
+{
     uint8_t key[MUM_KEY_SIZE];
     uint8_t subkeys[MUM_NUM_SUBKEYS][MUM_KEY_SIZE];
+    // subkeys are derived when first read, see CMumEngine::Subkey
+    bool subkeyValid[MUM_NUM_SUBKEYS];
 
     // permutation tables
     uint32_t permuteTables3bit[MUM_NUM_ROUNDS][MUM_NUM_3BIT_VALUES];
@@ -227,17 +286,56 @@ typedef struct TMumInfo
     uint32_t positionTables5bitXI[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
     uint32_t positionTables5bitYI[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
 
-    // precomputed texture data, 8-bit unsigned
-    uint8_t bitmaskTextureData[MUM_NUM_ROUNDS][MUM_MASK_TABLE_ROWS*MUM_NUM_8BIT_VALUES];
-    uint8_t permuteTextureData[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_NUM_8BIT_VALUES];
-    uint8_t permuteTextureDataI[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_NUM_8BIT_VALUES];
-    uint8_t positionTextureDataX[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
-    uint8_t positionTextureDataY[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
-    uint8_t positionTextureDataYB[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
-    uint8_t positionTextureDataXI[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
-    uint8_t positionTextureDataYI[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
-    uint8_t positionTextureDataYIB[MUM_NUM_ROUNDS][MUM_CELLS_MAX_Y][MUM_CELLS_X][MUM_NUM_POSITIONS];
-    uint8_t xorTextureData[MUM_NUM_8BIT_VALUES*MUM_NUM_8BIT_VALUES];
+    // compact per-round schedule read by the CPU kernels
+    TMumRoundSchedule schedule[MUM_NUM_ROUNDS];
+    // byte gather indices for the 128-byte block kernel, which keeps the
+    // block in registers; one row only
+    uint8_t vbmiDiffuseIndex[MUM_NUM_ROUNDS][MUM_NUM_POSITIONS][MUM_BLOCK_SIZE_R1];
+    uint8_t vbmiDiffuseIndexI[MUM_NUM_ROUNDS][MUM_NUM_POSITIONS][MUM_BLOCK_SIZE_R1];
+} TMumKeyTables;
+
+typedef struct TMumInfo 
+{
+    EMumEngineType engineType;
+    EMumBlockType blockType;
+    EMumKernelType kernelType;
+    EMumKernelMode kernelMode;
+    EMumScheduleType scheduleType;
+    bool paddingOn;
+    bool keyInitialized;
+    uint32_t numRows;
+    uint32_t plaintextBlockSize;
+    uint32_t encryptedBlockSize;
+    uint32_t paddingSize;
+    uint32_t numRoundsPerBlock;
+
+    // scalar kernels instantiated for numRows, see MumSelectScalarKernels
+    TMumBlockKernel encryptScalar;
+    TMumBlockKernel decryptScalar;
+    TMumBlockKernel encryptFusedScalar;
+    TMumBlockKernel decryptFusedScalar;
+    // key-specialized diffuse code for MUM_KERNEL_MODE_JIT, see mumjit.h
+    struct TMumJitCode *jitCode;
+    TMumCpuKernels cpuKernels;
+
+    // the tables of the key, owned by the engine or attached read-only, see
+    // CMumEngine::AttachSharedKey
+    TMumKeyTables *tables;
+    // the subkeys the renderers read, set with each key: those of tables, or
+    // of the engine whose key an engine for another block type runs, see
+    // CMumEngine::BlockTypeEngine
+    uint8_t (*subkeys)[MUM_KEY_SIZE];
+    // With MUM_SCHEDULE_TYPE_POSITION_TABLES, one 256-entry table per byte
+    // position and round with the subkey folded in, in positionPermuteTables;
+    // the scalar kernels use them instead of subkey and permute. Null
+    // otherwise.
+    uint8_t *positionPermute[MUM_NUM_ROUNDS];
+    uint8_t *positionPermuteI[MUM_NUM_ROUNDS];
+    uint8_t *positionPermuteTables;
+
+    // texture data of the GPU renderers, allocated by them; null for the
+    // CPU engines
+    struct TMumTextureData *textureData;
 } TMumInfo;
 
 
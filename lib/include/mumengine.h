@@ -28,10 +28,18 @@
 #include "mumdefines.h"
 #include "mumprng.h"
 #include "mumrenderer.h"
+#include "mumschedulefile.h"
+#include <atomic>
+#include <pthread.h>
 #ifdef USE_OPENGL
 #include "mumglwrapper.h"
 #endif
 
+class CMumContext;
+class CMumKeyStore;
+struct TMumKeyStoreEntry;
+struct TMumKeyCacheEntry;
+
 class CMumEngine
 {
 public:
@@ -39,7 +47,18 @@ public:
     ~CMumEngine();
     EMumError InitKey(uint8_t *key);
     EMumError LoadKey(const char *keyfile);
+    EMumError SaveKeySchedule(const char *schedulefile);
+    EMumError LoadKeySchedule(const char *schedulefile);
+    EMumError InitSharedKey(uint8_t *key, const char *name);
+    EMumError InitStoreKey(CMumKeyStore *keyStore, uint32_t keyId);
+    EMumError ExpandKey(uint8_t *key, TMumKeyTables *tables);
     EMumError GetSubkey(uint32_t index, uint8_t *subkey);
+    EMumError SetKernelType(EMumKernelType kernelType);
+    EMumKernelType GetKernelType();
+    EMumError SetKernelMode(EMumKernelMode kernelMode);
+    EMumKernelMode GetKernelMode();
+    EMumError SetScheduleType(EMumScheduleType scheduleType);
+    EMumScheduleType GetScheduleType();
     uint32_t PlaintextBlockSize();
     uint32_t EncryptedBlockSize();
     uint32_t EncryptedSize(uint32_t plaintextSize);
@@ -50,12 +69,55 @@ public:
     EMumError DecryptFile(const char *srcfile, const char *dstfile);
     EMumError Encrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum);
     EMumError Decrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength);
+    // Encrypt and Decrypt with any block type under the engine's key, see
+    // BlockTypeEngine; MUM_BLOCKTYPE_INVALID to decrypt finds the block type
+    EMumError EncryptWithBlockType(EMumBlockType blockType, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum);
+    EMumError DecryptWithBlockType(EMumBlockType *blockType, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength);
+
+    // a new CMumContext over mMumInfo; null for the GPU engines or before a
+    // key is loaded
+    CMumContext *CreateContext();
 
 private:
     TMumInfo mMumInfo;
+    // the tables mMumInfo points to unless a shared schedule, key store
+    // entry or key cache entry is attached, then null; null too before the
+    // first key
+    TMumKeyTables *mOwnTables;
+    // the attached shared schedule or schedule file; map is null when there
+    // is none
+    TMumScheduleFile mSharedTables;
+    // the attached key store entry, referenced until detached; or null
+    CMumKeyStore *mKeyStore;
+    struct TMumKeyStoreEntry *mKeyStoreEntry;
+    // the attached key cache entry, referenced until detached; or null
+    struct TMumKeyCacheEntry *mKeyCacheEntry;
+    // CPU-MT: the tables and position tables the workers read while the
+    // next key is set up in the others, see BeginKeyChange
+    TMumKeyTables *mSpareTables;
+    uint8_t *mSparePositionPermuteTables;
+    // what the previous key used, released by EndKeyChange once the
+    // renderer has the new one
+    TMumScheduleFile mRetiredSharedTables;
+    CMumKeyStore *mRetiredKeyStore;
+    struct TMumKeyStoreEntry *mRetiredKeyStoreEntry;
+    struct TMumKeyCacheEntry *mRetiredKeyCacheEntry;
+    struct TMumJitCode *mRetiredJitCode;
     CMumRenderer *mMumRenderer;
+    std::atomic<uint32_t> mNumContexts;
+    // PRNG subkey sets read by the renderer, see InitSubkeys
+    uint32_t mNumPrngSets;
+    // engines for the other block types, created when first used and keyed
+    // from the subkeys of this one after each key change
+    CMumEngine *mBlockTypeEngines[MUM_BLOCKTYPE_4096 + 1];
+    // for one of those, the engine whose subkeys it reads; else null
+    CMumEngine *mSubkeyOwner;
+    bool mBlockTypeKeyed[MUM_BLOCKTYPE_4096 + 1];
+    // held from BeginKeyChange to EndKeyChange, so that key changes take
+    // turns; also taken by the setters, and where subkeys may be derived
+    // while renderers or contexts run
+    pthread_mutex_t mKeyMutex;
     uint32_t GetSubkeyInteger(uint8_t *subkey, uint32_t offset);
-    void InitXorTextureData();
     void CreatePermuteTable(uint8_t *subkey, uint32_t numEntries, uint32_t *outTable);
     void CreatePrimeCycleWithOffset(uint32_t primeIndex, uint32_t offset, uint8_t *outCycle);
 
@@ -63,10 +125,30 @@ private:
     static CMumGlWrapper *mMumGlWrapper;
 #endif
 
-    void InitSubkeys();
-    void InitPermuteTables();
+    uint8_t *Subkey(uint32_t s);
+    TMumKeyTables *SubkeyTables();
+    static void DeriveSubkeys(void *param, uint32_t part, uint32_t numParts);
+    void InitSubkeys(bool allSubkeys);
+    void InitSubkeys(bool allSubkeys, uint32_t numRows);
+    void InitPermuteTables(const TMumInfo *source);
+    void InitPositionPermuteTables();
     void InitPositionTables();
     void InitBitmasks();
+    void InitSchedule();
+    void InitTables(const TMumInfo *source);
+    void InitTextureData();
+    void ActivateKey();
+    void BeginKeyChange();
+    void EndKeyChange();
+    void AbortKeyChange();
+    EMumError ReserveTables(bool ownTables);
+    void UseOwnTables();
+    void DetachTables();
+    EMumError AttachTables(TMumKeyTables *tables, const uint8_t *positionPermuteTables);
+    EMumError PublishSharedKey(uint8_t *key, TMumScheduleFile *shared, TMumKeyTables *tables);
+    EMumError InitKeyFromOwner(const TMumInfo *source);
+    EMumError BlockTypeEngine(EMumBlockType blockType, CMumEngine **engine);
+    EMumError FindBlockType(uint8_t *src, uint32_t length, EMumBlockType *blockType);
 };
 
 
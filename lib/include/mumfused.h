@@ -0,0 +1,39 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef MUMFUSED_H
+#define MUMFUSED_H
+
+#include "mumdefines.h"
+
+// Fused round kernels for the CPU engines (MUM_KERNEL_MODE_FUSED). Confuse
+// is applied to each cell as the diffuse pass produces it, so a round reads
+// one buffer and writes the other once. For decrypt, the inverse confuse of
+// round r-1 is applied to the output of the inverse diffuse of round r.
+// src and dst are the block before and after all rounds; work0 and work1
+// are the renderer's ping-pong blocks.
+void MumEncryptRoundsFused(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1);
+void MumDecryptRoundsFused(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1);
+
+#endif
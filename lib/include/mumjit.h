@@ -0,0 +1,57 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef MUMJIT_H
+#define MUMJIT_H
+
+#include "mumdefines.h"
+
+// MUM_KERNEL_MODE_JIT: once the key is known, the gather offsets and masks
+// of the diffuse pass are constants, so each round's diffuse is emitted as
+// straight-line x86-64 code with the offsets as displacements and the masks
+// as immediates: per destination byte, four byte loads, four ANDs, three
+// ORs and a store. The code lives in one mmap region, writable while it is
+// emitted and executable afterwards.
+typedef void (*TMumJitDiffuse)(const uint8_t *src, uint8_t *dst);
+
+typedef struct TMumJitCode
+{
+    uint8_t *code;
+    size_t size;
+    TMumJitDiffuse encryptDiffuse[MUM_NUM_ROUNDS];
+    TMumJitDiffuse decryptDiffuse[MUM_NUM_ROUNDS];
+} TMumJitCode;
+
+// false when built without USE_JIT or not on x86-64
+bool MumJitSupported();
+
+// emits the code for the current round schedule into mumInfo->jitCode,
+// replacing earlier code. On failure jitCode is null and the CPU engines
+// run the table kernels.
+bool MumJitBuild(TMumInfo *mumInfo);
+void MumJitFree(TMumInfo *mumInfo);
+// frees code taken out of a TMumInfo; null is ignored
+void MumJitFreeCode(TMumJitCode *jitCode);
+
+#endif
@@ -0,0 +1,99 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef MUMKEYCACHE_H
+#define MUMKEYCACHE_H
+
+#include "mumdefines.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <list>
+
+// 64-bit FNV-1a of the key; picks the cache entries to compare
+uint64_t MumKeyDigest(const uint8_t *key);
+// bytes of the position tables of the block type of mumInfo
+size_t MumPositionTablesSize(TMumInfo *mumInfo);
+// Copies the position tables from positionPermuteTables when given and the
+// schedule type uses them; otherwise mumInfo is left without position
+// tables, for CMumEngine::InitPositionPermuteTables.
+void MumCopyPositionTables(TMumInfo *mumInfo, const uint8_t *positionPermuteTables);
+
+// Process-wide cache of key schedules, shared by all engines. An entry holds
+// the key tables CMumEngine::InitKey derives from a key for one block type,
+// with every subkey derived, and the position tables if the engine that
+// built it used them. Engines attach the tables of an entry read-only, as
+// they do those of a key store, and hold a reference on it meanwhile; an
+// entry evicted while attached is only freed by the last reference. Entries
+// are found by a digest of the key and confirmed against the full key. The
+// cache is empty and off until a budget is set; least recently used entries
+// are evicted to stay within the budget.
+typedef struct TMumKeyCacheEntry
+{
+    uint64_t digest;
+    EMumBlockType blockType;
+    TMumKeyTables *tables;
+    uint8_t *positionPermuteTables;
+    size_t size;
+    uint32_t refCount;
+    bool evicted;
+} TMumKeyCacheEntry;
+
+class CMumKeyCache {
+public:
+    static CMumKeyCache *Instance();
+
+    // the entry of key for the block type of mumInfo, referenced; or null
+    TMumKeyCacheEntry *Acquire(const uint8_t *key, TMumInfo *mumInfo);
+    // true if an entry for mumInfo fits the budget
+    bool Accepts(TMumInfo *mumInfo);
+    // Caches the tables of mumInfo, every subkey derived, and returns the
+    // new entry, referenced; the entry owns them from then on. Null if the
+    // key is cached already, the entry does not fit or its position tables
+    // cannot be allocated; the tables are then left to the caller.
+    TMumKeyCacheEntry *Store(TMumInfo *mumInfo);
+    void Release(TMumKeyCacheEntry *entry);
+
+    void SetBudget(size_t budget);
+    void GetUsage(size_t *size, uint32_t *numEntries);
+    // evicts the entries of key, of all block types
+    void Evict(uint8_t *key);
+    void Clear();
+
+private:
+    CMumKeyCache();
+    ~CMumKeyCache();
+    size_t EntrySize(TMumInfo *mumInfo);
+    std::list<TMumKeyCacheEntry *>::iterator Find(uint64_t digest, const uint8_t *key, EMumBlockType blockType);
+    void EvictEntry(std::list<TMumKeyCacheEntry *>::iterator it);
+    void EvictToBudget(size_t budget);
+    void Unreference(TMumKeyCacheEntry *entry);
+
+    pthread_mutex_t mMutex;
+    // most recently used first
+    std::list<TMumKeyCacheEntry *> mEntries;
+    size_t mBudget;
+    size_t mSize;
+};
+
+#endif
@@ -0,0 +1,98 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef MUMKEYSTORE_H
+#define MUMKEYSTORE_H
+
+#include "mumdefines.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <list>
+#include <vector>
+
+class CMumEngine;
+
+// An expanded key of a key store, all subkeys derived. Engines hold a
+// reference while attached to it, so an entry evicted meanwhile is only
+// freed by the last reference.
+typedef struct TMumKeyStoreEntry
+{
+    TMumKeyTables *tables;
+    uint32_t keyId;
+    uint32_t refCount;
+    bool evicted;
+    // in CMumKeyStore::mEntries, until evicted
+    std::list<struct TMumKeyStoreEntry *>::iterator position;
+} TMumKeyStoreEntry;
+
+// an added key, and its expansion while it is in the store
+typedef struct TMumKeyStoreKey
+{
+    uint8_t key[MUM_KEY_SIZE];
+    TMumKeyStoreEntry *entry;
+} TMumKeyStoreKey;
+
+// Key store of MumCreateKeyStore. Keys are kept as added and expanded on
+// first use by a private engine; the least recently used expansions are
+// evicted to stay within the budget, and expanded again on their next use.
+class CMumKeyStore {
+public:
+    CMumKeyStore(EMumBlockType blockType, size_t budget);
+    ~CMumKeyStore();
+
+    EMumBlockType BlockType() { return mBlockType; }
+    EMumError Add(uint8_t *key, uint32_t *keyId);
+    EMumError Remove(uint32_t keyId);
+    void SetBudget(size_t budget);
+    void GetStats(TMumKeyStoreStats *stats);
+
+    // the expansion of keyId, referenced, expanding it if needed
+    EMumError Acquire(uint32_t keyId, TMumKeyStoreEntry **entry);
+    void Release(TMumKeyStoreEntry *entry);
+
+private:
+    bool HasKey(uint32_t keyId, uint8_t *key);
+    bool Hit(uint32_t keyId, TMumKeyStoreEntry **entry);
+    void EvictEntry(TMumKeyStoreEntry *entry);
+    void EvictToBudget(size_t budget);
+    void Unreference(TMumKeyStoreEntry *entry);
+
+    EMumBlockType mBlockType;
+    pthread_mutex_t mMutex;
+    // null where a key was removed; ids are reused from mFreeIds
+    std::vector<TMumKeyStoreKey *> mKeys;
+    std::vector<uint32_t> mFreeIds;
+    // most recently used first
+    std::list<TMumKeyStoreEntry *> mEntries;
+    size_t mBudget;
+    size_t mSize;
+    uint64_t mHits;
+    uint64_t mMisses;
+    uint64_t mEvictions;
+    // expands keys, one at a time under mExpandMutex
+    CMumEngine *mEngine;
+    pthread_mutex_t mExpandMutex;
+};
+
+#endif
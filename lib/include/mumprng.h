@@ -36,11 +36,14 @@ class CMumPrng
 {
 public:
     CMumPrng(uint8_t *subkeyData);
+    // a stream of its own for each stream id over the same subkey data;
+    // stream 0 is the one above
+    CMumPrng(uint8_t *subkeyData, uint32_t stream);
     ~CMumPrng();
     void Fetch(uint8_t *dst, uint32_t size);
 
 private:
-    void Init();
+    void Init(uint32_t stream);
     void Regenerate();
     void Generate(uint8_t *dst, uint32_t size);
     void XorWithSubkey();
@@ -40,6 +40,8 @@ typedef enum EMumEngineType {
     MUM_ENGINE_TYPE_CPU_MT = 101,
     MUM_ENGINE_TYPE_GPU_A  = 102,
     MUM_ENGINE_TYPE_GPU_B  = 103,
+    // single threaded, runs batches of MUM_BITSLICE_BLOCKS blocks bitsliced
+    MUM_ENGINE_TYPE_CPU_BITSLICE = 104,
 } EMumEngineType;
 
 typedef enum EMumError {
@@ -65,6 +67,18 @@ typedef enum EMumError {
     MUM_ERROR_INVALID_ENCRYPTED_BLOCK_LENGTH = -1019,
     MUM_ERROR_INVALID_ENCRYPTED_BLOCK_CHECKSUM = -1020,
     MUM_ERROR_KEYFILE_SMALL = -1021,
+    MUM_ERROR_KERNEL_NOT_SUPPORTED = -1022,
+    MUM_ERROR_SCHEDULEFILE_READ = -1023,
+    MUM_ERROR_SCHEDULEFILE_WRITE = -1024,
+    MUM_ERROR_SCHEDULEFILE_INVALID = -1025,
+    MUM_ERROR_SCHEDULEFILE_BLOCKTYPE = -1026,
+    MUM_ERROR_SHAREDKEY_NOT_FOUND = -1027,
+    MUM_ERROR_SHAREDKEY_CREATE = -1028,
+    MUM_ERROR_KEYSTORE_KEY_NOT_FOUND = -1029,
+    MUM_ERROR_KEYSTORE_BLOCKTYPE = -1030,
+    MUM_ERROR_SHAREDKEY_PRIVATE = -1031,
+    MUM_ERROR_SHAREDKEY_NAME = -1032,
+    MUM_ERROR_OUT_OF_MEMORY = -1033,
 } EMumError;
 
 typedef enum EMumBlockType {
@@ -88,21 +102,162 @@ typedef enum EMumPaddingType {
     MUM_PADDING_TYPE_ON = 1,
 } EMumPaddingType;
 
+// Instruction set used by the CPU engines for the round kernels.
+// All kernel types produce identical encrypted blocks.
+typedef enum EMumKernelType {
+    // best kernel supported by this CPU, chosen when the engine is created
+    MUM_KERNEL_TYPE_AUTO = 0,
+    MUM_KERNEL_TYPE_SCALAR = 1,
+    // vectorized confuse pass, scalar diffuse pass
+    MUM_KERNEL_TYPE_SSSE3 = 2,
+    MUM_KERNEL_TYPE_AVX2 = 3,
+    // 128-byte blocks only; the whole block stays in two ZMM registers
+    MUM_KERNEL_TYPE_AVX512VBMI = 4,
+} EMumKernelType;
+
+// How the CPU engines run the rounds of a block. All modes produce
+// identical encrypted blocks; the setting exists for benchmarking.
+typedef enum EMumKernelMode {
+    // diffuse and confuse as two passes over the block, one per round
+    MUM_KERNEL_MODE_TWO_PASS = 0,
+    // one pass per round, confuse applied to each cell as it is diffused
+    MUM_KERNEL_MODE_FUSED = 1,
+    // SIMD kernel types only: 16 blocks at a time, interleaved byte by byte
+    // so that each table entry is read once for all of them. The remaining
+    // blocks of a call, and the scalar kernel type, run two-pass.
+    MUM_KERNEL_MODE_BATCH = 2,
+    // two passes, the diffuse pass generated as x86-64 code for the key at
+    // MumInitKey; confuse as for the kernel type. Needs a USE_JIT build.
+    MUM_KERNEL_MODE_JIT = 3,
+} EMumKernelMode;
+
+// Confuse tables of the scalar kernels of the CPU engines.
+typedef enum EMumScheduleType {
+    // position tables only where those of a round fit in L1, which is
+    // true of no block type at present; row tables otherwise
+    MUM_SCHEDULE_TYPE_AUTO = 0,
+    // one 256-entry table per row, the subkey XOR done in the kernel
+    MUM_SCHEDULE_TYPE_ROW_TABLES = 1,
+    // one 256-entry table per byte position with the subkey XOR folded in,
+    // 256 times the block size per round and direction
+    MUM_SCHEDULE_TYPE_POSITION_TABLES = 2,
+} EMumScheduleType;
+
+// counters of a key store, see MumGetKeyStoreStats
+typedef struct TMumKeyStoreStats {
+    // uses of a key that found it expanded, or expanded it
+    uint64_t hits;
+    uint64_t misses;
+    // expansions evicted to stay within the budget
+    uint64_t evictions;
+    uint32_t numKeys;
+    uint32_t numExpanded;
+    // bytes of the expansions held, and the budget
+    size_t size;
+    size_t budget;
+} TMumKeyStoreStats;
 
 extern void * MumCreateEngine(EMumEngineType engineType, EMumBlockType blockType, EMumPaddingType paddingType, uint32_t numThreads);
 extern void MumDestroyEngine(void *me);
+// A multi-threaded engine may change keys while another thread encrypts or
+// decrypts with it: the key is set up alongside the current one, and each
+// call runs under one key throughout. Key changes from several threads take
+// turns; which key is left is that of the last to run. One that runs out of
+// memory returns MUM_ERROR_OUT_OF_MEMORY and leaves the current key.
 extern EMumError MumInitKey(void *me, uint8_t *key);
 extern EMumError MumGetSubkey(void *me, uint32_t index, uint8_t *subkey);
 extern EMumError MumLoadKey(void *me, const char *keyfile);
+// Saves the expanded key of an engine, or loads one instead of expanding a
+// key, for one block type. The file is versioned and checksummed, mapped
+// read-only when loaded and used in place until the next key change, and as
+// secret as the key it was expanded from. It must not be rewritten while an
+// engine has it loaded.
+extern EMumError MumSaveKeySchedule(void *me, const char *schedulefile);
+extern EMumError MumLoadKeySchedule(void *me, const char *schedulefile);
+// Like MumInitKey, but the expanded key is shared read-only by all processes
+// of the host that use it: attaches the POSIX shared memory segment of name
+// and the block type if a process published it, else expands the key and
+// publishes it. Segment names are visible to every local user, so name
+// should not be derived from the key; up to 200 characters, without '/'.
+// The segment is readable by the owning user only, as secret as the key,
+// and stays until MumUnlinkSharedKey. Without shared memory, while another
+// process is still writing the segment, or if it holds another key, the
+// engine expands the key privately and MUM_ERROR_SHAREDKEY_PRIVATE is
+// returned; the engine can then be used as after MumInitKey.
+extern EMumError MumInitSharedKey(void *me, uint8_t *key, const char *name);
+// removes the segment of name and block type; attached engines keep it mapped
+extern EMumError MumUnlinkSharedKey(EMumBlockType blockType, const char *name);
 extern EMumError MumEncryptBlock(void *me, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t seqnum);
 extern EMumError MumDecryptBlock(void *me, uint8_t *src, uint8_t *dst, uint32_t *length, uint32_t *seqnum);
 extern EMumError MumEncrypt(void *me, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum);
 extern EMumError MumDecrypt(void *me, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength);
+// MumEncrypt and MumDecrypt with any block type under the key of the
+// engine, instead of an engine and a key setup per block type. The first
+// call for another block type after a key change sets up its tables, from
+// the subkeys and permute tables the engine already has. Other block types
+// run on one thread, a CPU one for a CPU-MT engine, and calls with them take
+// turns with each other and with key changes. blockType
+// MUM_BLOCKTYPE_INVALID to decrypt is set to the block type found from the
+// first encrypted block, which needs padding on. That is costly: each block
+// type the length allows may be tried, and one not yet set up for the key
+// takes its tables, a few MB, and up to about 20ms to set up. Block types
+// already set up are tried first; pass the block type when it is known.
+extern EMumError MumEncryptWithBlockType(void *me, EMumBlockType blockType, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum);
+extern EMumError MumDecryptWithBlockType(void *me, EMumBlockType *blockType, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength);
 extern EMumError MumEncryptFile(void *me, const char *srcfile, const char *dstfile);
 extern EMumError MumDecryptFile(void *me, const char *srcfile, const char *dstfile);
 extern EMumError MumPlaintextBlockSize(void *me, uint32_t *plaintextBlockSize);
 extern EMumError MumEncryptedBlockSize(void *me, uint32_t *encryptedBlockSize);
 extern EMumError MumEncryptedSize(void *me, uint32_t plaintextSize, uint32_t *encryptedSize);
+// overrides the kernel type chosen at engine creation; CPU engines only
+extern EMumError MumSetKernelType(void *me, EMumKernelType kernelType);
+extern EMumError MumGetKernelType(void *me, EMumKernelType *kernelType);
+extern EMumError MumSetKernelMode(void *me, EMumKernelMode kernelMode);
+extern EMumError MumGetKernelMode(void *me, EMumKernelMode *kernelMode);
+// CPU engines only; tables are rebuilt right away if a key is loaded
+extern EMumError MumSetScheduleType(void *me, EMumScheduleType scheduleType);
+extern EMumError MumGetScheduleType(void *me, EMumScheduleType *scheduleType);
+// Per-thread contexts over one engine's key schedule, CPU engines only;
+// NULL for the GPU engines or if no key is loaded. Each context can be used
+// from its own thread concurrently with the others. The engine must outlive
+// its contexts, and its key, kernel type, mode and schedule type must not
+// change while a context is in use.
+extern void * MumCreateContext(void *me);
+extern void MumDestroyContext(void *mc);
+extern EMumError MumContextEncrypt(void *mc, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum);
+extern EMumError MumContextDecrypt(void *mc, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength);
+// Process-wide cache of key schedules: MumInitKey and MumLoadKey attach the
+// schedule of a key and block type in the cache, if another engine built
+// it already, instead of deriving it again; engines with the same key share
+// one schedule. Thread-safe. Off until a budget in bytes is set; an entry
+// takes about 4MB. Setting a smaller budget evicts the least recently used
+// entries, 0 evicts all.
+extern EMumError MumSetKeyCacheBudget(size_t budget);
+extern EMumError MumGetKeyCacheUsage(size_t *size, uint32_t *numEntries);
+// evicts the schedules of key, of all block types; engines attached to one
+// keep it until they change keys
+extern EMumError MumEvictKey(uint8_t *key);
+// 1 allocates the position tables of later keys, of 2MB or more, from huge
+// pages where the system has them, with the USE_HUGEPAGES build option; 0,
+// the default, from the heap. Key schedules are always on the heap, so
+// subkeys derived when first read take memory only then.
+extern EMumError MumSetHugePages(uint32_t enable);
+// Key store for many keys of one block type, such as one per tenant: keys
+// are added once and expanded when first used, and the least recently used
+// expansions are evicted to stay within the budget in bytes, about 4MB an
+// expansion, then expanded again on their next use. Thread-safe. Any
+// engine of the block type, or several at once, encrypts with a key of the
+// store after MumInitStoreKey, which attaches the expansion read-only
+// instead of copying it; the store must outlive those engines.
+extern void * MumCreateKeyStore(EMumBlockType blockType, size_t budget);
+extern void MumDestroyKeyStore(void *ks);
+extern EMumError MumKeyStoreAdd(void *ks, uint8_t *key, uint32_t *keyId);
+// an engine attached to the key keeps its expansion until its key changes
+extern EMumError MumKeyStoreRemove(void *ks, uint32_t keyId);
+extern EMumError MumSetKeyStoreBudget(void *ks, size_t budget);
+extern EMumError MumGetKeyStoreStats(void *ks, TMumKeyStoreStats *stats);
+// like MumInitKey, with key keyId of the store, expanding it if it is not
+extern EMumError MumInitStoreKey(void *me, void *ks, uint32_t keyId);
 // adds a file extension to a file based, based on the block size/type:
 // .mu1 = 128-byte block
 // .mu2 = 256-byte block
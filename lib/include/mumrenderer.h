@@ -29,6 +29,9 @@
 #include "mumdefines.h"
 #include "mumprng.h"
 
+// part of numParts of a task, see CMumRenderer::RunParallel
+typedef void (*TMumParallelTask)(void *param, uint32_t part, uint32_t numParts);
+
 class CMumRenderer {
 
 public:
@@ -36,6 +39,10 @@ public:
     CMumRenderer(TMumInfo *mumInfo);
     virtual ~CMumRenderer();
 
+    // sets the block and padding sizes of mumInfo for its block type; the
+    // engine calls it once, before any renderer is created
+    static void InitBlockGeometry(TMumInfo *mumInfo);
+
     virtual EMumError EncryptBlock(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t seqnum);
     virtual EMumError DecryptBlock(uint8_t *src, uint8_t *dst, uint32_t *length, uint32_t *seqnum);
     virtual EMumError Encrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum);
@@ -52,6 +59,25 @@ public:
     virtual void DecryptDownload(uint8_t *data) = 0;
     virtual void InitKey() = 0;
 
+    // all rounds of one block: upload, diffuse/confuse, download. Renderers
+    // with a whole-block kernel override these.
+    virtual void EncryptRounds(uint8_t *src, uint8_t *dst);
+    virtual void DecryptRounds(uint8_t *src, uint8_t *dst);
+
+    // number of blocks the renderer runs at once, see MUM_KERNEL_MODE_BATCH,
+    // and the rounds for that many blocks, stored at the given strides
+    virtual uint32_t BatchSize() { return 1; }
+    virtual void EncryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride);
+    virtual void DecryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride);
+
+    // runs all parts of task, on the worker threads where the renderer has
+    // them, and returns when they are done
+    virtual void RunParallel(TMumParallelTask task, void *param) { task(param, 0, 1); }
+
+    // the engine changed mMumInfo outside InitKey; renderers that keep a
+    // copy of it take the change over
+    virtual void PublishInfo() {}
+
     void ResetEncryption() { numEncryptedBlocks = 0; }
     void ResetDecryption() { numDecryptedBlocks = 0; }
 protected:
@@ -61,28 +87,27 @@ protected:
     int64_t numDecryptedBlocks;
     int64_t blockLatency;
     uint8_t  mPackedData[MUM_MAX_BLOCK_SIZE];
-    uint8_t mPingPongBlock[2][MUM_MAX_BLOCK_SIZE];
+    uint8_t *mBatchBlocks;
+    uint32_t mBatchBlocksCapacity;
     uint8_t mPadding[MUM_PADDING_SIZE_R32];
     uint8_t mTable[256];
 
 
-    uint32_t ComputeChecksum(uint8_t *data, uint32_t size);
     void SetPadding(uint8_t *src, uint32_t length);
-
-    EMumError(CMumRenderer::*packData)(uint8_t *unpackedData, uint32_t length, uint32_t seqnum);
-    EMumError(CMumRenderer::*unpackData)(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum);
-    EMumError PackDataR32(uint8_t *unpackedData, uint32_t length, uint32_t seqnum);
-    EMumError PackDataR16(uint8_t *unpackedData, uint32_t length, uint32_t seqnum);
-    EMumError PackDataR8(uint8_t *unpackedData, uint32_t length, uint32_t seqnum);
-    EMumError PackDataR4(uint8_t *unpackedData, uint32_t length, uint32_t seqnum);
-    EMumError PackDataR2(uint8_t *unpackedData, uint32_t length, uint32_t seqnum);
-    EMumError PackDataR1(uint8_t *unpackedData, uint32_t length, uint32_t seqnum);
-    EMumError UnpackDataR32(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum);
-    EMumError UnpackDataR16(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum);
-    EMumError UnpackDataR8(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum);
-    EMumError UnpackDataR4(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum);
-    EMumError UnpackDataR2(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum);
-    EMumError UnpackDataR1(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum);
+    uint8_t *BatchBlocks(uint32_t batchSize);
+    EMumError EncryptBatch(uint8_t *src, uint8_t *dst, uint16_t seqNum);
+    EMumError DecryptBatch(uint8_t *src, uint8_t *dst, uint32_t *length);
+    // mMumInfo->textureData for the GPU renderers, filled by the engine's
+    // InitKey except for the key-independent xor table
+    void CreateTextureData();
+    void DeleteTextureData();
+
+    EMumError(CMumRenderer::*packData)(uint8_t *packedData, uint8_t *unpackedData, uint32_t length, uint32_t seqnum);
+    EMumError(CMumRenderer::*unpackData)(uint8_t *packedData, uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum);
+    template <typename TGeometry>
+    EMumError PackData(uint8_t *packedData, uint8_t *unpackedData, uint32_t length, uint32_t seqnum);
+    template <typename TGeometry>
+    EMumError UnpackData(uint8_t *packedData, uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum);
 
 };
 
@@ -0,0 +1,88 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef MUMSCHEDULEFILE_H
+#define MUMSCHEDULEFILE_H
+
+#include "mumdefines.h"
+#include <stddef.h>
+
+// Key schedule file, see MumSaveKeySchedule: a header page, then the
+// TMumKeyTables of the key (all subkeys derived) and, if the saving engine
+// had them, its position tables, each section starting on a page boundary.
+// The checksum covers both sections. The tables are this build's
+// TMumKeyTables layout; a layout change bumps the version. Shared schedules,
+// see MumInitSharedKey, are the same format in a POSIX shared memory
+// segment named after the caller's name and the block type, without
+// position tables.
+#define MUM_SCHEDULE_FILE_MAGIC     0x44454843534d554dull   // "MUMSCHED"
+#define MUM_SCHEDULE_FILE_VERSION   2
+#define MUM_SCHEDULE_FILE_ALIGN     4096
+#define MUM_SHARED_SCHEDULE_NAME_MAX 200
+
+typedef struct TMumScheduleFileHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t blockType;
+    uint64_t tablesOffset;
+    uint64_t tablesSize;
+    uint64_t positionTablesOffset;
+    uint64_t positionTablesSize;
+    uint64_t checksum;
+} TMumScheduleFileHeader;
+
+// a schedule file or shared schedule mapped read-only; positionPermuteTables
+// is null when it has none
+typedef struct TMumScheduleFile
+{
+    void *map;
+    size_t mapSize;
+    const TMumKeyTables *tables;
+    const uint8_t *positionPermuteTables;
+    // a shared schedule being written holds an exclusive flock on it, on
+    // this descriptor; -1 otherwise
+    int lockFd;
+} TMumScheduleFile;
+
+EMumError MumWriteScheduleFile(TMumInfo *mumInfo, const char *schedulefile);
+// maps schedulefile and checks it against the block type of mumInfo, and
+// that it holds every subkey
+EMumError MumMapScheduleFile(TMumInfo *mumInfo, const char *schedulefile, TMumScheduleFile *scheduleFile);
+void MumUnmapScheduleFile(TMumScheduleFile *scheduleFile);
+
+// Creates the shared schedule name for the block type of mumInfo, if none
+// exists, and maps it writable: the key is expanded straight into tables,
+// all subkeys derived, and the schedule is then published by
+// MumCompleteSharedSchedule, which writes its header and maps it read-only.
+EMumError MumCreateSharedSchedule(TMumInfo *mumInfo, const char *name, TMumScheduleFile *scheduleFile, TMumKeyTables **tables);
+void MumCompleteSharedSchedule(TMumInfo *mumInfo, TMumScheduleFile *scheduleFile);
+// Maps the shared schedule name for the block type of mumInfo, if one was
+// published, is complete and is that of key. A segment without a valid
+// header that no publisher holds a lock on was left by one that died; it
+// is unlinked, and NOT_FOUND returned so that the key is published again.
+EMumError MumMapSharedSchedule(TMumInfo *mumInfo, uint8_t *key, const char *name, TMumScheduleFile *scheduleFile);
+EMumError MumUnlinkSharedSchedule(EMumBlockType blockType, const char *name);
+
+#endif
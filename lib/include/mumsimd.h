@@ -0,0 +1,86 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef MUMSIMD_H
+#define MUMSIMD_H
+
+#include "mumdefines.h"
+
+// CPU feature checks, evaluated once per process
+bool MumKernelTypeSupported(EMumKernelType kernelType, EMumBlockType blockType);
+EMumKernelType MumBestKernelType(EMumBlockType blockType);
+
+// For each position, the byte of the 4-byte source cell that ends up in
+// byte 0, 1, 2 and 3 of the destination cell; see the diffuse kernels.
+extern const uint8_t mumEncryptSourceBytes[MUM_NUM_POSITIONS][MUM_CELL_SIZE];
+extern const uint8_t mumDecryptSourceBytes[MUM_NUM_POSITIONS][MUM_CELL_SIZE];
+
+// builds the vbmi* tables of TMumInfo from the round schedule; only used
+// for 128-byte blocks
+void MumInitVbmiTables(TMumInfo *mumInfo);
+
+#ifdef USE_SIMD
+// AVX2 diffuse pass: eight 4-byte cells per iteration, gathered from src with
+// vpgatherdd and written to dst. Output is identical to the scalar kernels.
+void MumEncryptDiffuseAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+void MumDecryptDiffuseAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+
+// Confuse pass: XOR with the round subkey and 256-entry substitution, the
+// substitution done as 16 pshufb lookups, one per 16-entry table slice, each
+// kept where the high nibble of the index selects that slice.
+void MumEncryptConfuseSsse3(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+void MumDecryptConfuseSsse3(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+void MumEncryptConfuseAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+void MumDecryptConfuseAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+
+// Fused rounds, see mumfused.h: encrypt diffuse and confuse of round, and
+// decrypt inverse diffuse of round followed by inverse confuse of round - 1.
+void MumEncryptRoundFusedAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+void MumDecryptRoundFusedAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+
+// MUM_KERNEL_MODE_BATCH: all rounds of MUM_BATCH_BLOCKS blocks at once. The
+// blocks are transposed into work0 so that byte n of every block forms one
+// vector, one lane per block; each table entry is then read once for the
+// whole batch. Blocks are read from src and written to dst at the strides.
+// The rounds use AVX2 when the kernel type allows it, SSSE3 otherwise.
+void MumEncryptBatch(TMumInfo *mumInfo, uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride,
+                     uint8_t *work0, uint8_t *work1);
+void MumDecryptBatch(TMumInfo *mumInfo, uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride,
+                     uint8_t *work0, uint8_t *work1);
+void MumEncryptRoundBatchAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+void MumDecryptConfuseBatchAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *data);
+void MumDecryptRoundBatchAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst);
+
+// One subkey: byte i is the XOR over the MUM_NUM_CYCLES prime cycles of
+// key[(offsets[c] + i * primes[c]) & MUM_KEY_MASK], eight bytes per step
+// with vpgatherdd. Output is identical to CMumEngine::Subkey.
+void MumXorPrimeCyclesAvx2(uint8_t *key, uint32_t *primes, uint32_t *offsets, uint8_t *subkey);
+
+// AVX-512 VBMI, 128-byte blocks: all rounds of one block, src to dst. Both
+// diffuse and confuse are vpermi2b byte gathers over registers.
+void MumEncryptBlockVbmi(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst);
+void MumDecryptBlockVbmi(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst);
+#endif
+
+#endif
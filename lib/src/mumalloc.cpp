@@ -0,0 +1,115 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumalloc.h"
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unordered_map>
+
+static std::atomic<bool> hugePages(false);
+
+// the mapped allocations and their sizes, so that they need no header,
+// which would take them past a multiple of the huge page size
+static pthread_mutex_t mappedMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::unordered_map<void *, size_t> mapped;
+
+void MumAllocSetHugePages(bool enable)
+{
+#ifdef USE_HUGEPAGES
+    hugePages = enable;
+#endif
+}
+
+// mapSize bytes, a multiple of MUM_HUGE_PAGE_SIZE, or null
+static void *MapHugePages(size_t mapSize)
+{
+    // fails when none are reserved, or all of them are taken
+#ifdef MAP_HUGETLB
+    void *hugetlb = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (hugetlb != MAP_FAILED)
+        return hugetlb;
+#endif
+
+    // transparent huge pages need the range aligned: map a huge page more
+    // and unmap what lies outside the aligned range
+    void *pages = mmap(nullptr, mapSize + MUM_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED)
+        return nullptr;
+    uint8_t *start = (uint8_t *)pages;
+    uint8_t *aligned = (uint8_t *)(((uintptr_t)start + MUM_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(MUM_HUGE_PAGE_SIZE - 1));
+    if (aligned > start)
+        munmap(start, aligned - start);
+    munmap(aligned + mapSize, start + MUM_HUGE_PAGE_SIZE - aligned);
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, mapSize, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+void *MumAlloc(size_t size)
+{
+    void *allocated;
+    if (posix_memalign(&allocated, MUM_ALLOC_ALIGNMENT, size) != 0)
+        return nullptr;
+    return allocated;
+}
+
+void *MumAllocHugePages(size_t size)
+{
+    if (hugePages && size >= MUM_HUGE_PAGE_SIZE)
+    {
+        size_t mapSize = (size + MUM_HUGE_PAGE_SIZE - 1) & ~(size_t)(MUM_HUGE_PAGE_SIZE - 1);
+        void *pages = MapHugePages(mapSize);
+        if (pages != nullptr)
+        {
+            pthread_mutex_lock(&mappedMutex);
+            mapped[pages] = mapSize;
+            pthread_mutex_unlock(&mappedMutex);
+            return pages;
+        }
+    }
+    return MumAlloc(size);
+}
+
+void MumFree(void *ptr)
+{
+    if (ptr == nullptr)
+        return;
+    size_t mapSize = 0;
+    pthread_mutex_lock(&mappedMutex);
+    auto found = mapped.find(ptr);
+    if (found != mapped.end())
+    {
+        mapSize = found->second;
+        mapped.erase(found);
+    }
+    pthread_mutex_unlock(&mappedMutex);
+    if (mapSize != 0)
+        munmap(ptr, mapSize);
+    else
+        free(ptr);
+}
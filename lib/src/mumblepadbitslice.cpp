@@ -0,0 +1,245 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumblepadbitslice.h"
+#include "mumsimd.h"
+#include "mumalloc.h"
+#include <string.h>
+
+#define MUM_ROW_SIZE (MUM_CELLS_X * MUM_CELL_SIZE)
+
+// 8x8 bit matrix transpose, bit c of byte r <-> bit r of byte c
+static inline uint64_t TransposeBits(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    return x;
+}
+
+// 8x8 byte matrix transpose, byte c of word r <-> byte r of word c
+static inline void TransposeBytes(uint64_t *w)
+{
+    uint64_t t;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        t = ((w[i] >> 32) ^ w[i + 4]) & 0x00000000FFFFFFFFULL;
+        w[i] ^= t << 32;
+        w[i + 4] ^= t;
+    }
+    for (uint32_t i = 0; i < 8; i += (i & 1) ? 3 : 1)
+    {
+        t = ((w[i] >> 16) ^ w[i + 2]) & 0x0000FFFF0000FFFFULL;
+        w[i] ^= t << 16;
+        w[i + 2] ^= t;
+    }
+    for (uint32_t i = 0; i < 8; i += 2)
+    {
+        t = ((w[i] >> 8) ^ w[i + 1]) & 0x00FF00FF00FF00FFULL;
+        w[i] ^= t << 8;
+        w[i + 1] ^= t;
+    }
+}
+
+// one byte of 64 blocks, block j in byte j, to the 8 planes of that byte
+static inline void BytesToPlanes(uint64_t *w)
+{
+    for (uint32_t g = 0; g < 8; g++)
+        w[g] = TransposeBits(w[g]);
+    TransposeBytes(w);
+}
+
+static inline void PlanesToBytes(uint64_t *w)
+{
+    TransposeBytes(w);
+    for (uint32_t g = 0; g < 8; g++)
+        w[g] = TransposeBits(w[g]);
+}
+
+CMumblepadBitslice::CMumblepadBitslice(TMumInfo *mumInfo) : CMumblepad(mumInfo)
+{
+    mPlanes[0] = (uint64_t *)MumAlloc(MUM_MAX_BLOCK_SIZE * 8 * sizeof(uint64_t));
+    mPlanes[1] = (uint64_t *)MumAlloc(MUM_MAX_BLOCK_SIZE * 8 * sizeof(uint64_t));
+}
+
+CMumblepadBitslice::~CMumblepadBitslice()
+{
+    MumFree(mPlanes[0]);
+    MumFree(mPlanes[1]);
+}
+
+void CMumblepadBitslice::SliceIn(uint8_t *src, uint32_t srcStride, uint64_t *planes)
+{
+    uint64_t words[MUM_BITSLICE_BLOCKS];
+    uint32_t b, i, g, j;
+
+    // 8 bytes of every block at a time
+    for (b = 0; b < mMumInfo->encryptedBlockSize; b += 8)
+    {
+        for (j = 0; j < MUM_BITSLICE_BLOCKS; j++)
+            memcpy(&words[j], src + j * srcStride + b, 8);
+        // words[g * 8 + i] is now byte b + i of blocks 8g .. 8g + 7
+        for (g = 0; g < 8; g++)
+            TransposeBytes(&words[g * 8]);
+        for (i = 0; i < 8; i++)
+        {
+            uint64_t *p = planes + (b + i) * 8;
+            for (g = 0; g < 8; g++)
+                p[g] = words[g * 8 + i];
+            BytesToPlanes(p);
+        }
+    }
+}
+
+void CMumblepadBitslice::SliceOut(uint64_t *planes, uint8_t *dst, uint32_t dstStride)
+{
+    uint64_t words[MUM_BITSLICE_BLOCKS];
+    uint64_t p[8];
+    uint32_t b, i, g, j;
+
+    for (b = 0; b < mMumInfo->encryptedBlockSize; b += 8)
+    {
+        for (i = 0; i < 8; i++)
+        {
+            memcpy(p, planes + (b + i) * 8, sizeof(p));
+            PlanesToBytes(p);
+            for (g = 0; g < 8; g++)
+                words[g * 8 + i] = p[g];
+        }
+        for (g = 0; g < 8; g++)
+            TransposeBytes(&words[g * 8]);
+        for (j = 0; j < MUM_BITSLICE_BLOCKS; j++)
+            memcpy(dst + j * dstStride + b, &words[j], 8);
+    }
+}
+
+void CMumblepadBitslice::DiffusePlanes(TMumRoundSchedule *schedule, uint16_t *gather, const uint8_t sourceBytes[MUM_NUM_POSITIONS][MUM_CELL_SIZE], uint64_t *src, uint64_t *dst)
+{
+    uint32_t position[8];
+    uint32_t offset[MUM_CELL_SIZE][8];
+    uint32_t n, i, k, p, numCells;
+
+    // each bit is taken from the one position whose mask holds it
+    for (k = 0; k < 8; k++)
+        for (p = 0; p < MUM_NUM_POSITIONS; p++)
+            if (schedule->bitmasks[p] & (1 << k))
+                position[k] = p;
+    for (i = 0; i < MUM_CELL_SIZE; i++)
+        for (k = 0; k < 8; k++)
+            offset[i][k] = sourceBytes[position[k]][i] * 8 + k;
+
+    numCells = mMumInfo->numRows * MUM_CELLS_X;
+    for (n = 0; n < numCells; n++)
+    {
+        for (i = 0; i < MUM_CELL_SIZE; i++)
+        {
+            for (k = 0; k < 8; k++)
+                dst[k] = src[gather[position[k]] * 8 + offset[i][k]];
+            dst += 8;
+        }
+        gather += 4;
+    }
+}
+
+void CMumblepadBitslice::EncryptConfusePlanes(TMumRoundSchedule *schedule, uint64_t *planes)
+{
+    uint64_t w[8];
+    uint8_t *bytes = (uint8_t *)w;
+    uint32_t b, k, j;
+
+    for (b = 0; b < mMumInfo->encryptedBlockSize; b++)
+    {
+        uint8_t *prm = schedule->permute[b / MUM_ROW_SIZE];
+        uint8_t key = schedule->subkey[b];
+        for (k = 0; k < 8; k++)
+            w[k] = planes[k] ^ (0 - (uint64_t)((key >> k) & 1));
+        PlanesToBytes(w);
+        for (j = 0; j < MUM_BITSLICE_BLOCKS; j++)
+            bytes[j] = prm[bytes[j]];
+        BytesToPlanes(w);
+        memcpy(planes, w, sizeof(w));
+        planes += 8;
+    }
+}
+
+void CMumblepadBitslice::DecryptConfusePlanes(TMumRoundSchedule *schedule, uint64_t *planes)
+{
+    uint64_t w[8];
+    uint8_t *bytes = (uint8_t *)w;
+    uint32_t b, k, j;
+
+    for (b = 0; b < mMumInfo->encryptedBlockSize; b++)
+    {
+        uint8_t *prm = schedule->permuteI[b / MUM_ROW_SIZE];
+        uint8_t key = schedule->subkey[b];
+        memcpy(w, planes, sizeof(w));
+        PlanesToBytes(w);
+        for (j = 0; j < MUM_BITSLICE_BLOCKS; j++)
+            bytes[j] = prm[bytes[j]];
+        BytesToPlanes(w);
+        for (k = 0; k < 8; k++)
+            planes[k] = w[k] ^ (0 - (uint64_t)((key >> k) & 1));
+        planes += 8;
+    }
+}
+
+void CMumblepadBitslice::EncryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride)
+{
+    uint64_t *a = mPlanes[0];
+    uint64_t *b = mPlanes[1];
+
+    SliceIn(src, srcStride, a);
+    for (uint32_t r = 0; r < mMumInfo->numRoundsPerBlock; r++)
+    {
+        TMumRoundSchedule *schedule = &mMumInfo->tables->schedule[r];
+        DiffusePlanes(schedule, schedule->gather[0], mumEncryptSourceBytes, a, b);
+        EncryptConfusePlanes(schedule, b);
+        uint64_t *t = a;
+        a = b;
+        b = t;
+    }
+    SliceOut(a, dst, dstStride);
+}
+
+void CMumblepadBitslice::DecryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride)
+{
+    uint64_t *a = mPlanes[0];
+    uint64_t *b = mPlanes[1];
+
+    SliceIn(src, srcStride, a);
+    for (int r = mMumInfo->numRoundsPerBlock - 1; r >= 0; r--)
+    {
+        TMumRoundSchedule *schedule = &mMumInfo->tables->schedule[r];
+        DecryptConfusePlanes(schedule, a);
+        DiffusePlanes(schedule, schedule->gatherI[0], mumDecryptSourceBytes, a, b);
+        uint64_t *t = a;
+        a = b;
+        b = t;
+    }
+    SliceOut(a, dst, dstStride);
+}
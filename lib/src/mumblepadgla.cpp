@@ -198,6 +198,7 @@ CMumblepadGla::CMumblepadGla(TMumInfo *mumInfo, CMumGlWrapper *mumGlWrapper) : C
         mPositionTexturesYI[round] = -1;
     }
     mLutTextureXor = -1;
+    CreateTextureData();
     if (!InitGl())
         assert(0);
 }
@@ -235,6 +236,7 @@ CMumblepadGla::~CMumblepadGla()
     mGlw->glDeleteProgram(mDecryptConfuseProgram);
     DeleteFrameBuffers();
     DeleteLutTextures();
+    DeleteTextureData();
     if (mPrng != nullptr)
     {
         delete mPrng;
@@ -302,7 +304,7 @@ bool CMumblepadGla::CreateLutTextures()
     mGlw->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     mGlw->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     mGlw->glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, MUM_NUM_8BIT_VALUES, MUM_NUM_8BIT_VALUES, 0, GL_LUMINANCE,
-                       GL_UNSIGNED_BYTE, mMumInfo->xorTextureData);
+                       GL_UNSIGNED_BYTE, mMumInfo->textureData->xorTextureData);
 
     for (round = 0; round < MUM_NUM_ROUNDS; round++)
     {
@@ -404,31 +406,31 @@ void CMumblepadGla::WriteTextures()
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mLutTextureBitmask[round]);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MUM_NUM_8BIT_VALUES, MUM_MASK_TABLE_ROWS,
-                              GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->bitmaskTextureData[round]);
+                              GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->textureData->bitmaskTextureData[round]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mPositionTexturesX[round]);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MUM_CELLS_X,
-                              mMumInfo->numRows, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->positionTextureDataX[round]);
+                              mMumInfo->numRows, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->textureData->positionTextureDataX[round]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mPositionTexturesY[round]);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MUM_CELLS_X,
-                              mMumInfo->numRows, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->positionTextureDataY[round]);
+                              mMumInfo->numRows, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->textureData->positionTextureDataY[round]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mPositionTexturesXI[round]);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MUM_CELLS_X,
-                              mMumInfo->numRows, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->positionTextureDataXI[round]);
+                              mMumInfo->numRows, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->textureData->positionTextureDataXI[round]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mPositionTexturesYI[round]);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MUM_CELLS_X,
-                              mMumInfo->numRows, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->positionTextureDataYI[round]);
+                              mMumInfo->numRows, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->textureData->positionTextureDataYI[round]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mLutTexturePermute[round]);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MUM_NUM_8BIT_VALUES,
-                              mMumInfo->numRows, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->permuteTextureData[round]);
+                              mMumInfo->numRows, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->textureData->permuteTextureData[round]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mLutTexturePermuteI[round]);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MUM_NUM_8BIT_VALUES,
-                              mMumInfo->numRows, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->permuteTextureDataI[round]);
+                              mMumInfo->numRows, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->textureData->permuteTextureDataI[round]);
     }
 }
 
@@ -209,6 +209,7 @@ CMumblepadGlb::CMumblepadGlb(TMumInfo *mumInfo, CMumGlWrapper *gelbGlWrapper) :
     mLutTextureKey = -1;
     mLutTextureKeyI = -1;
     mLutTextureXor = -1;
+    CreateTextureData();
     if (!InitGl())
         assert(0);
 }
@@ -243,6 +244,7 @@ CMumblepadGlb::~CMumblepadGlb()
     mGlw->glDeleteProgram(mDecryptConfuseProgram);
     DeleteFrameBuffers();
     DeleteLutTextures();
+    DeleteTextureData();
     if (mPrng != nullptr)
     {
         delete mPrng;
@@ -331,7 +333,7 @@ bool CMumblepadGlb::CreateLutTextures()
     mGlw->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     mGlw->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     mGlw->glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, MUM_NUM_8BIT_VALUES, MUM_NUM_8BIT_VALUES, 0, GL_LUMINANCE,
-                       GL_UNSIGNED_BYTE, mMumInfo->xorTextureData);
+                       GL_UNSIGNED_BYTE, mMumInfo->textureData->xorTextureData);
 
     mGlw->glGenTextures(1, &mLutTextureBitmask);
     mGlw->glBindTexture(GL_TEXTURE_2D, mLutTextureBitmask);
@@ -435,35 +437,35 @@ void CMumblepadGlb::WriteTextures()
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mLutTexturePermute);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, r * MUM_CELLS_MAX_Y, MUM_NUM_8BIT_VALUES,
-                              MUM_CELLS_MAX_Y, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->permuteTextureData[r]);
+                              MUM_CELLS_MAX_Y, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->textureData->permuteTextureData[r]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mLutTexturePermuteI);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, r * MUM_CELLS_MAX_Y, MUM_NUM_8BIT_VALUES,
-                              MUM_CELLS_MAX_Y, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->permuteTextureDataI[indicesB[r]]);
+                              MUM_CELLS_MAX_Y, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->textureData->permuteTextureDataI[indicesB[r]]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mLutTextureBitmask);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, r * MUM_CELLS_MAX_Y, MUM_NUM_8BIT_VALUES,
-                              MUM_CELLS_MAX_Y, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->bitmaskTextureData[r]);
+                              MUM_CELLS_MAX_Y, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->textureData->bitmaskTextureData[r]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mLutTextureBitmaskI);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, (7 - r) * MUM_CELLS_MAX_Y, MUM_NUM_8BIT_VALUES,
-                              MUM_CELLS_MAX_Y, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->bitmaskTextureData[r]);
+                              MUM_CELLS_MAX_Y, GL_LUMINANCE, GL_UNSIGNED_BYTE, mMumInfo->textureData->bitmaskTextureData[r]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mPositionTexturesX);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, r * MUM_CELLS_MAX_Y, MUM_CELLS_X,
-                              MUM_CELLS_MAX_Y, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->positionTextureDataX[r]);
+                              MUM_CELLS_MAX_Y, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->textureData->positionTextureDataX[r]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mPositionTexturesY);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, r * MUM_CELLS_MAX_Y, MUM_CELLS_X,
-                              MUM_CELLS_MAX_Y, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->positionTextureDataYB[r]);
+                              MUM_CELLS_MAX_Y, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->textureData->positionTextureDataYB[r]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mPositionTexturesXI);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, (7 - r) * MUM_CELLS_MAX_Y, MUM_CELLS_X,
-                              MUM_CELLS_MAX_Y, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->positionTextureDataXI[r]);
+                              MUM_CELLS_MAX_Y, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->textureData->positionTextureDataXI[r]);
 
         mGlw->glBindTexture(GL_TEXTURE_2D, mPositionTexturesYI);
         mGlw->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, (7 - r) * MUM_CELLS_MAX_Y, MUM_CELLS_X,
-                              MUM_CELLS_MAX_Y, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->positionTextureDataYIB[r]);
+                              MUM_CELLS_MAX_Y, GL_RGBA, GL_UNSIGNED_BYTE, mMumInfo->textureData->positionTextureDataYIB[r]);
     }
 }
 
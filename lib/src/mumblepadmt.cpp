@@ -32,7 +32,10 @@
 
 CMumblepadMt::CMumblepadMt(TMumInfo *mumInfo, uint32_t numThreads) : CMumRenderer(mumInfo)
 {
-    mMumInfo = mumInfo;
+    mEngineInfo = mumInfo;
+    mLiveInfo = *mumInfo;
+    mMumInfo = &mLiveInfo;
+    pthread_mutex_init(&mJobMutex, NULL);
     mNumThreads = numThreads;
     mStarted = false;
     for (int i = 0; i < MUM_MAX_THREADS; i++)
@@ -48,6 +51,24 @@ CMumblepadMt::~CMumblepadMt()
     for (uint32_t i = 0; i < mNumThreads; i++)
         delete mThreads[i];
     delete mServerSignal;
+    pthread_mutex_destroy(&mJobMutex);
+}
+
+// the new key and PRNG seeds for the workers, once the job running is done
+void CMumblepadMt::InitKey()
+{
+    pthread_mutex_lock(&mJobMutex);
+    mLiveInfo = *mEngineInfo;
+    for (uint32_t i = 0; i < mNumThreads; i++)
+        mThreads[i]->InitKey();
+    pthread_mutex_unlock(&mJobMutex);
+}
+
+void CMumblepadMt::PublishInfo()
+{
+    pthread_mutex_lock(&mJobMutex);
+    mLiveInfo = *mEngineInfo;
+    pthread_mutex_unlock(&mJobMutex);
 }
 
 
@@ -61,14 +82,20 @@ EMumError CMumblepadMt::EncryptBlock(uint8_t *src, uint8_t *dst, uint32_t length
 {
     if (mNumThreads == 0 || mThreads[0] == nullptr)
         return MUM_ERROR_MTRENDERER_NO_THREADS;
-    return mThreads[0]->EncryptBlock(src, dst, length, seqnum);
+    pthread_mutex_lock(&mJobMutex);
+    EMumError error = mThreads[0]->EncryptBlock(src, dst, length, seqnum);
+    pthread_mutex_unlock(&mJobMutex);
+    return error;
 }
 
 EMumError CMumblepadMt::DecryptBlock(uint8_t *src, uint8_t *dst, uint32_t *length, uint32_t *seqnum)
 {
     if (mNumThreads == 0 || mThreads[0] == nullptr)
         return MUM_ERROR_MTRENDERER_NO_THREADS;
-    return mThreads[0]->DecryptBlock(src, dst, length, seqnum);
+    pthread_mutex_lock(&mJobMutex);
+    EMumError error = mThreads[0]->DecryptBlock(src, dst, length, seqnum);
+    pthread_mutex_unlock(&mJobMutex);
+    return error;
 }
 
 
@@ -76,6 +103,7 @@ EMumError CMumblepadMt::Encrypt(uint8_t *src, uint8_t *dst, uint32_t length, uin
 {
     uint32_t plaintextSize, encryptedSize;
 
+    pthread_mutex_lock(&mJobMutex);
     *outlength = 0;
     for (uint32_t i = 0; i < mNumThreads; i++)
         mThreads[i]->mEncryptLength = 0;
@@ -145,6 +173,7 @@ EMumError CMumblepadMt::Encrypt(uint8_t *src, uint8_t *dst, uint32_t length, uin
     }
     for (uint32_t i = 0; i < mNumThreads; i++)
         *outlength += mThreads[i]->mEncryptLength;
+    pthread_mutex_unlock(&mJobMutex);
     return MUM_ERROR_OK;
 }
 
@@ -152,6 +181,7 @@ EMumError CMumblepadMt::Decrypt(uint8_t *src, uint8_t *dst, uint32_t length, uin
 {
     uint32_t plaintextSize, encryptedSize;
 
+    pthread_mutex_lock(&mJobMutex);
     for (uint32_t i = 0; i < mNumThreads; i++)
         mThreads[i]->mDecryptLength = 0;
 
@@ -217,5 +247,43 @@ EMumError CMumblepadMt::Decrypt(uint8_t *src, uint8_t *dst, uint32_t length, uin
     }
     for (uint32_t i = 0; i < mNumThreads; i++)
         *outlength += mThreads[i]->mDecryptLength;
+    pthread_mutex_unlock(&mJobMutex);
     return MUM_ERROR_OK;
 }
+
+// one part per thread; Encrypt and Decrypt leave all threads done
+void CMumblepadMt::RunParallel(TMumParallelTask task, void *param)
+{
+    if (mNumThreads == 0)
+    {
+        task(param, 0, 1);
+        return;
+    }
+    pthread_mutex_lock(&mJobMutex);
+    for (uint32_t i = 0; i < mNumThreads; i++)
+    {
+        TMumJob job;
+        job.state = MUM_JOB_STATE_NONE;
+        job.type = MUM_JOB_TYPE_TASK;
+        job.id = i + 1;
+        job.task = task;
+        job.param = param;
+        job.part = i;
+        job.numParts = mNumThreads;
+        mThreads[i]->mJob = job;
+        mThreads[i]->mJob.state = MUM_JOB_STATE_ASSIGNED;
+        mThreads[i]->mWorkerSignal->DoSignal();
+    }
+    while (true)
+    {
+        bool working = false;
+        for (uint32_t i = 0; i < mNumThreads; i++)
+        {
+            if (mThreads[i]->mJob.state != MUM_JOB_STATE_DONE)
+                working = true;
+        }
+        if (!working)
+            break;
+    }
+    pthread_mutex_unlock(&mJobMutex);
+}
@@ -0,0 +1,54 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumcontext.h"
+
+CMumContext::CMumContext(TMumInfo *mumInfo, uint32_t id) : CMumblepad(mumInfo)
+{
+    mId = id;
+    InitKey();
+}
+
+void CMumContext::InitKey()
+{
+    if (mPrng != nullptr)
+    {
+        delete mPrng;
+        mPrng = nullptr;
+    }
+    // the renderer and CPU-MT threads use stream 0 of the sets
+    mPrng = new CMumPrng(mMumInfo->subkeys[MUM_PRNG_SUBKEY_INDEX + (mId & 15) * 16], mId);
+}
+
+EMumError CMumContext::Encrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum)
+{
+    ResetEncryption();
+    return CMumRenderer::Encrypt(src, dst, length, outlength, seqNum);
+}
+
+EMumError CMumContext::Decrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength)
+{
+    ResetDecryption();
+    return CMumRenderer::Decrypt(src, dst, length, outlength);
+}
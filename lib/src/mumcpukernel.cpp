@@ -0,0 +1,318 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumcpukernel.h"
+#include "mumscalar.h"
+#include "mumsimd.h"
+#include "mumfused.h"
+#include "mumjit.h"
+#include <string.h>
+
+static void EncryptDiffuseScalar(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    uint32_t n, numCells;
+    uint32_t maskA, maskB, maskC, maskD;
+    uint8_t *mappedSrc1, *mappedSrc2, *mappedSrc3, *mappedSrc4;
+    uint16_t *gather;
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+
+    maskA = schedule->bitmasks[0];
+    maskB = schedule->bitmasks[1];
+    maskC = schedule->bitmasks[2];
+    maskD = schedule->bitmasks[3];
+    gather = schedule->gather[0];
+    numCells = mumInfo->numRows * MUM_CELLS_X;
+    for (n = 0; n < numCells; n++)
+    {
+        mappedSrc1 = src + gather[0];
+        mappedSrc2 = src + gather[1];
+        mappedSrc3 = src + gather[2];
+        mappedSrc4 = src + gather[3];
+        dst[0] = (mappedSrc1[0] & maskA) + (mappedSrc2[2] & maskB) + (mappedSrc3[3] & maskC) + (mappedSrc4[1] & maskD);
+        dst[1] = (mappedSrc1[2] & maskA) + (mappedSrc2[3] & maskB) + (mappedSrc3[1] & maskC) + (mappedSrc4[0] & maskD);
+        dst[2] = (mappedSrc1[3] & maskA) + (mappedSrc2[1] & maskB) + (mappedSrc3[0] & maskC) + (mappedSrc4[2] & maskD);
+        dst[3] = (mappedSrc1[1] & maskA) + (mappedSrc2[0] & maskB) + (mappedSrc3[2] & maskC) + (mappedSrc4[3] & maskD);
+        dst += 4;
+        gather += 4;
+    }
+}
+
+static void EncryptConfuseScalar(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    uint32_t x, y;
+    uint8_t *prm;
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint8_t *clav = schedule->subkey;
+
+    for (y = 0; y < mumInfo->numRows; y++)
+    {
+        prm = schedule->permute[y];
+        for (x = 0; x < MUM_CELLS_X; x++)
+        {
+            *dst++ = prm[(uint8_t)(*src++ ^ *clav++)];
+            *dst++ = prm[(uint8_t)(*src++ ^ *clav++)];
+            *dst++ = prm[(uint8_t)(*src++ ^ *clav++)];
+            *dst++ = prm[(uint8_t)(*src++ ^ *clav++)];
+        }
+    }
+}
+
+static void DecryptConfuseScalar(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    uint32_t x, y;
+    uint8_t *prm;
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint8_t *clav = schedule->subkey;
+
+    for (y = 0; y < mumInfo->numRows; y++)
+    {
+        prm = schedule->permuteI[y];
+        for (x = 0; x < MUM_CELLS_X; x++)
+        {
+            *dst++ = prm[*src++] ^ *clav++;
+            *dst++ = prm[*src++] ^ *clav++;
+            *dst++ = prm[*src++] ^ *clav++;
+            *dst++ = prm[*src++] ^ *clav++;
+        }
+    }
+}
+
+static void DecryptDiffuseScalar(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    uint32_t n, numCells;
+    uint32_t maskA, maskB, maskC, maskD;
+    uint8_t *mappedSrc1, *mappedSrc2, *mappedSrc3, *mappedSrc4;
+    uint16_t *gather;
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+
+    maskA = schedule->bitmasks[0];
+    maskB = schedule->bitmasks[1];
+    maskC = schedule->bitmasks[2];
+    maskD = schedule->bitmasks[3];
+    gather = schedule->gatherI[0];
+    numCells = mumInfo->numRows * MUM_CELLS_X;
+    for (n = 0; n < numCells; n++)
+    {
+        mappedSrc1 = src + gather[0];
+        mappedSrc2 = src + gather[1];
+        mappedSrc3 = src + gather[2];
+        mappedSrc4 = src + gather[3];
+        *dst++ = (mappedSrc1[0] & maskA) + (mappedSrc2[3] & maskB) + (mappedSrc3[2] & maskC) + (mappedSrc4[1] & maskD);
+        *dst++ = (mappedSrc1[3] & maskA) + (mappedSrc2[2] & maskB) + (mappedSrc3[1] & maskC) + (mappedSrc4[0] & maskD);
+        *dst++ = (mappedSrc1[1] & maskA) + (mappedSrc2[0] & maskB) + (mappedSrc3[3] & maskC) + (mappedSrc4[2] & maskD);
+        *dst++ = (mappedSrc1[2] & maskA) + (mappedSrc2[1] & maskB) + (mappedSrc3[0] & maskC) + (mappedSrc4[3] & maskD);
+        gather += 4;
+    }
+}
+
+static void EncryptDiffuseJit(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    mumInfo->jitCode->encryptDiffuse[round](src, dst);
+}
+
+static void DecryptDiffuseJit(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    mumInfo->jitCode->decryptDiffuse[round](src, dst);
+}
+
+// per-round kernels through the table: the first diffuse reads src and the
+// last confuse writes dst, the rounds between stay in work0/1
+static void EncryptBlockTwoPass(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1)
+{
+    TMumCpuKernels *kernels = &mumInfo->cpuKernels;
+    for (uint32_t r = 0; r < mumInfo->numRoundsPerBlock; r++)
+    {
+        uint8_t *out = (r == mumInfo->numRoundsPerBlock - 1) ? dst : work0;
+        kernels->encryptDiffuse(mumInfo, r, src, work1);
+        kernels->encryptConfuse(mumInfo, r, work1, out);
+        src = out;
+    }
+}
+
+static void DecryptBlockTwoPass(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1)
+{
+    TMumCpuKernels *kernels = &mumInfo->cpuKernels;
+    for (int r = mumInfo->numRoundsPerBlock - 1; r >= 0; r--)
+    {
+        uint8_t *out = (r == 0) ? dst : work0;
+        kernels->decryptConfuse(mumInfo, (uint32_t)r, src, work1);
+        kernels->decryptDiffuse(mumInfo, (uint32_t)r, work1, out);
+        src = out;
+    }
+}
+
+#ifdef USE_SIMD
+static void EncryptBlockVbmi(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *, uint8_t *)
+{
+    MumEncryptBlockVbmi(mumInfo, src, dst);
+}
+
+static void DecryptBlockVbmi(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *, uint8_t *)
+{
+    MumDecryptBlockVbmi(mumInfo, src, dst);
+}
+#endif
+
+void MumSelectCpuKernels(TMumInfo *mumInfo)
+{
+    TMumCpuKernels *kernels = &mumInfo->cpuKernels;
+    EMumKernelType kernelType = mumInfo->kernelType;
+    EMumKernelMode kernelMode = mumInfo->kernelMode;
+    bool jit = (kernelMode == MUM_KERNEL_MODE_JIT && mumInfo->jitCode != nullptr);
+
+    MumSelectScalarKernels(mumInfo);
+
+    kernels->encryptDiffuse = jit ? EncryptDiffuseJit : EncryptDiffuseScalar;
+    kernels->decryptDiffuse = jit ? DecryptDiffuseJit : DecryptDiffuseScalar;
+    kernels->encryptConfuse = EncryptConfuseScalar;
+    kernels->decryptConfuse = DecryptConfuseScalar;
+    kernels->encryptBlock = EncryptBlockTwoPass;
+    kernels->decryptBlock = DecryptBlockTwoPass;
+    kernels->encryptBatch = nullptr;
+    kernels->decryptBatch = nullptr;
+    kernels->batchSize = 1;
+
+#ifdef USE_SIMD
+    if (kernelType == MUM_KERNEL_TYPE_AVX2)
+    {
+        if (!jit)
+        {
+            kernels->encryptDiffuse = MumEncryptDiffuseAvx2;
+            kernels->decryptDiffuse = MumDecryptDiffuseAvx2;
+        }
+        kernels->encryptConfuse = MumEncryptConfuseAvx2;
+        kernels->decryptConfuse = MumDecryptConfuseAvx2;
+    }
+    else if (kernelType == MUM_KERNEL_TYPE_SSSE3)
+    {
+        kernels->encryptConfuse = MumEncryptConfuseSsse3;
+        kernels->decryptConfuse = MumDecryptConfuseSsse3;
+    }
+    if (kernelMode == MUM_KERNEL_MODE_BATCH && kernelType != MUM_KERNEL_TYPE_SCALAR)
+    {
+        kernels->encryptBatch = MumEncryptBatch;
+        kernels->decryptBatch = MumDecryptBatch;
+        kernels->batchSize = MUM_BATCH_BLOCKS;
+    }
+    if (kernelType == MUM_KERNEL_TYPE_AVX512VBMI)
+    {
+        kernels->encryptBlock = EncryptBlockVbmi;
+        kernels->decryptBlock = DecryptBlockVbmi;
+        return;
+    }
+#endif
+    if (kernelMode == MUM_KERNEL_MODE_FUSED)
+    {
+        kernels->encryptBlock = MumEncryptRoundsFused;
+        kernels->decryptBlock = MumDecryptRoundsFused;
+    }
+    else if (kernelType == MUM_KERNEL_TYPE_SCALAR && kernelMode != MUM_KERNEL_MODE_JIT)
+    {
+        kernels->encryptBlock = mumInfo->encryptScalar;
+        kernels->decryptBlock = mumInfo->decryptScalar;
+    }
+}
+
+CMumCpuKernel::CMumCpuKernel(TMumInfo *mumInfo)
+{
+    mMumInfo = mumInfo;
+}
+
+void CMumCpuKernel::EncryptBlocks(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride, uint32_t numBlocks)
+{
+    TMumCpuKernels *kernels = &mMumInfo->cpuKernels;
+    uint32_t batchSize = kernels->batchSize;
+
+    while (batchSize > 1 && numBlocks >= batchSize)
+    {
+        kernels->encryptBatch(mMumInfo, src, srcStride, dst, dstStride, mBatchWork[0], mBatchWork[1]);
+        src += batchSize * srcStride;
+        dst += batchSize * dstStride;
+        numBlocks -= batchSize;
+    }
+    for (; numBlocks > 0; numBlocks--)
+    {
+        kernels->encryptBlock(mMumInfo, src, dst, mPingPongBlock[0], mPingPongBlock[1]);
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+void CMumCpuKernel::DecryptBlocks(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride, uint32_t numBlocks)
+{
+    TMumCpuKernels *kernels = &mMumInfo->cpuKernels;
+    uint32_t batchSize = kernels->batchSize;
+
+    while (batchSize > 1 && numBlocks >= batchSize)
+    {
+        kernels->decryptBatch(mMumInfo, src, srcStride, dst, dstStride, mBatchWork[0], mBatchWork[1]);
+        src += batchSize * srcStride;
+        dst += batchSize * dstStride;
+        numBlocks -= batchSize;
+    }
+    for (; numBlocks > 0; numBlocks--)
+    {
+        kernels->decryptBlock(mMumInfo, src, dst, mPingPongBlock[0], mPingPongBlock[1]);
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+void CMumCpuKernel::Upload(uint8_t *data)
+{
+    memcpy(mPingPongBlock[0], data, mMumInfo->encryptedBlockSize);
+}
+
+void CMumCpuKernel::Download(uint8_t *data)
+{
+    memcpy(data, mPingPongBlock[0], mMumInfo->encryptedBlockSize);
+}
+
+// first pass for encrypt
+// source = 0, destination = 1
+void CMumCpuKernel::EncryptDiffuse(uint32_t round)
+{
+    mMumInfo->cpuKernels.encryptDiffuse(mMumInfo, round, mPingPongBlock[0], mPingPongBlock[1]);
+}
+
+// second pass for encrypt
+// source = 1, destination = 0
+void CMumCpuKernel::EncryptConfuse(uint32_t round)
+{
+    mMumInfo->cpuKernels.encryptConfuse(mMumInfo, round, mPingPongBlock[1], mPingPongBlock[0]);
+}
+
+// first pass for decrypt
+// source = 0, destination = 1
+void CMumCpuKernel::DecryptConfuse(uint32_t round)
+{
+    mMumInfo->cpuKernels.decryptConfuse(mMumInfo, round, mPingPongBlock[0], mPingPongBlock[1]);
+}
+
+// second pass for decrypt
+// source = 1, destination = 0
+void CMumCpuKernel::DecryptDiffuse(uint32_t round)
+{
+    mMumInfo->cpuKernels.decryptDiffuse(mMumInfo, round, mPingPongBlock[1], mPingPongBlock[0]);
+}
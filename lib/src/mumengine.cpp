@@ -26,9 +26,19 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <utility>
 #include "mumengine.h"
 #include "mumblepad.h"
 #include "mumblepadmt.h"
+#include "mumblepadbitslice.h"
+#include "mumsimd.h"
+#include "mumjit.h"
+#include "mumcpukernel.h"
+#include "mumcontext.h"
+#include "mumkeycache.h"
+#include "mumschedulefile.h"
+#include "mumkeystore.h"
+#include "mumalloc.h"
 #ifdef USE_OPENGL
 #include "mumblepadgla.h"
 #include "mumblepadglb.h"
@@ -80,17 +90,56 @@ CMumEngine::CMumEngine(EMumEngineType engineType, EMumBlockType blockType, EMumP
     mMumInfo.paddingOn = (paddingType == MUM_PADDING_TYPE_ON);
     mMumInfo.blockType = blockType;
     mMumInfo.keyInitialized = false;
+    mMumInfo.textureData = nullptr;
+    // allocated with the first key, see ReserveTables
+    mOwnTables = nullptr;
+    mMumInfo.tables = nullptr;
+    mMumInfo.subkeys = nullptr;
+    mSubkeyOwner = nullptr;
+    mSharedTables.map = nullptr;
+    mKeyStore = nullptr;
+    mKeyStoreEntry = nullptr;
+    mKeyCacheEntry = nullptr;
+    mSpareTables = nullptr;
+    mSparePositionPermuteTables = nullptr;
+    mRetiredSharedTables.map = nullptr;
+    mRetiredKeyStore = nullptr;
+    mRetiredKeyStoreEntry = nullptr;
+    mRetiredKeyCacheEntry = nullptr;
+    mRetiredJitCode = nullptr;
+    mNumPrngSets = 1;
+    if (engineType == MUM_ENGINE_TYPE_CPU_MT)
+        mNumPrngSets = numThreads + 1 < 16 ? numThreads + 1 : 16;
+    for (uint32_t b = 0; b <= MUM_BLOCKTYPE_4096; b++)
+    {
+        mBlockTypeEngines[b] = nullptr;
+        mBlockTypeKeyed[b] = false;
+    }
+    pthread_mutex_init(&mKeyMutex, NULL);
+    mNumContexts = 0;
+    mMumInfo.kernelType = MUM_KERNEL_TYPE_SCALAR;
+    mMumInfo.kernelMode = MUM_KERNEL_MODE_TWO_PASS;
+    mMumInfo.jitCode = nullptr;
+    mMumInfo.scheduleType = MUM_SCHEDULE_TYPE_ROW_TABLES;
+    mMumInfo.positionPermuteTables = nullptr;
+    for (uint32_t round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        mMumInfo.positionPermute[round] = nullptr;
+        mMumInfo.positionPermuteI[round] = nullptr;
+    }
+    if (engineType == MUM_ENGINE_TYPE_CPU || engineType == MUM_ENGINE_TYPE_CPU_MT)
+        mMumInfo.kernelType = MumBestKernelType(blockType);
 
     mMumInfo.numRoundsPerBlock = 8;
 #ifdef USE_OPENGL
-    if (engineType >= MUM_ENGINE_TYPE_GPU_B)
+    if (engineType == MUM_ENGINE_TYPE_GPU_B)
         mMumInfo.numRoundsPerBlock = 1;
 #endif
 
-    InitXorTextureData();
+    CMumRenderer::InitBlockGeometry(&mMumInfo);
 
 #ifdef USE_OPENGL
-    if (engineType >= MUM_ENGINE_TYPE_GPU_A)
+    if (engineType == MUM_ENGINE_TYPE_GPU_A || engineType == MUM_ENGINE_TYPE_GPU_B)
     {
         if (mMumGlWrapper == NULL)
         {
@@ -107,6 +156,9 @@ CMumEngine::CMumEngine(EMumEngineType engineType, EMumBlockType blockType, EMumP
     case MUM_ENGINE_TYPE_CPU_MT:
         mMumRenderer = new CMumblepadMt(&mMumInfo, numThreads);
         break;
+    case MUM_ENGINE_TYPE_CPU_BITSLICE:
+        mMumRenderer = new CMumblepadBitslice(&mMumInfo);
+        break;
 #ifdef USE_OPENGL
     case MUM_ENGINE_TYPE_GPU_A:
         mMumRenderer = new CMumblepadGla(&mMumInfo, mMumGlWrapper);
@@ -118,11 +170,111 @@ CMumEngine::CMumEngine(EMumEngineType engineType, EMumBlockType blockType, EMumP
     default:
         assert(0);
     }
+    MumSelectCpuKernels(&mMumInfo);
+    SetScheduleType(MUM_SCHEDULE_TYPE_AUTO);
 }
 
 CMumEngine::~CMumEngine()
 {
+    for (uint32_t b = 0; b <= MUM_BLOCKTYPE_4096; b++)
+        delete mBlockTypeEngines[b];
     delete mMumRenderer;
+    MumJitFree(&mMumInfo);
+    MumFree(mMumInfo.positionPermuteTables);
+    MumFree(mSparePositionPermuteTables);
+    MumFree(mOwnTables);
+    MumFree(mSpareTables);
+    DetachTables();
+    pthread_mutex_destroy(&mKeyMutex);
+}
+
+EMumError CMumEngine::SetKernelType(EMumKernelType kernelType)
+{
+    if (mMumInfo.engineType != MUM_ENGINE_TYPE_CPU && mMumInfo.engineType != MUM_ENGINE_TYPE_CPU_MT)
+        return kernelType == MUM_KERNEL_TYPE_AUTO ? MUM_ERROR_OK : MUM_ERROR_KERNEL_NOT_SUPPORTED;
+    if (!MumKernelTypeSupported(kernelType, mMumInfo.blockType))
+        return MUM_ERROR_KERNEL_NOT_SUPPORTED;
+    if (kernelType == MUM_KERNEL_TYPE_AUTO)
+        kernelType = MumBestKernelType(mMumInfo.blockType);
+    pthread_mutex_lock(&mKeyMutex);
+    mMumInfo.kernelType = kernelType;
+    MumSelectCpuKernels(&mMumInfo);
+    mMumRenderer->PublishInfo();
+    pthread_mutex_unlock(&mKeyMutex);
+    return MUM_ERROR_OK;
+}
+
+EMumKernelType CMumEngine::GetKernelType()
+{
+    return mMumInfo.kernelType;
+}
+
+EMumError CMumEngine::SetKernelMode(EMumKernelMode kernelMode)
+{
+    if (mMumInfo.engineType != MUM_ENGINE_TYPE_CPU && mMumInfo.engineType != MUM_ENGINE_TYPE_CPU_MT)
+        return kernelMode == MUM_KERNEL_MODE_TWO_PASS ? MUM_ERROR_OK : MUM_ERROR_KERNEL_NOT_SUPPORTED;
+    if (kernelMode == MUM_KERNEL_MODE_JIT && !MumJitSupported())
+        return MUM_ERROR_KERNEL_NOT_SUPPORTED;
+    if (kernelMode != MUM_KERNEL_MODE_JIT && kernelMode != MUM_KERNEL_MODE_TWO_PASS &&
+        kernelMode != MUM_KERNEL_MODE_FUSED && kernelMode != MUM_KERNEL_MODE_BATCH)
+        return MUM_ERROR_KERNEL_NOT_SUPPORTED;
+    pthread_mutex_lock(&mKeyMutex);
+    // otherwise built by InitKey
+    if (kernelMode == MUM_KERNEL_MODE_JIT && mMumInfo.keyInitialized && mMumInfo.jitCode == nullptr)
+        MumJitBuild(&mMumInfo);
+    mMumInfo.kernelMode = kernelMode;
+    MumSelectCpuKernels(&mMumInfo);
+    mMumRenderer->PublishInfo();
+    pthread_mutex_unlock(&mKeyMutex);
+    return MUM_ERROR_OK;
+}
+
+EMumKernelMode CMumEngine::GetKernelMode()
+{
+    return mMumInfo.kernelMode;
+}
+
+EMumError CMumEngine::SetScheduleType(EMumScheduleType scheduleType)
+{
+    if (scheduleType != MUM_SCHEDULE_TYPE_AUTO && scheduleType != MUM_SCHEDULE_TYPE_ROW_TABLES &&
+        scheduleType != MUM_SCHEDULE_TYPE_POSITION_TABLES)
+        return MUM_ERROR_KERNEL_NOT_SUPPORTED;
+    // only the scalar kernels of the CPU engines read position tables
+    if (mMumInfo.engineType != MUM_ENGINE_TYPE_CPU && mMumInfo.engineType != MUM_ENGINE_TYPE_CPU_MT)
+    {
+        if (scheduleType == MUM_SCHEDULE_TYPE_POSITION_TABLES)
+            return MUM_ERROR_KERNEL_NOT_SUPPORTED;
+        scheduleType = MUM_SCHEDULE_TYPE_ROW_TABLES;
+    }
+    if (scheduleType == MUM_SCHEDULE_TYPE_AUTO)
+        scheduleType = mMumInfo.encryptedBlockSize * MUM_NUM_8BIT_VALUES <= MUM_POSITION_TABLES_MAX_SIZE ?
+            MUM_SCHEDULE_TYPE_POSITION_TABLES : MUM_SCHEDULE_TYPE_ROW_TABLES;
+    pthread_mutex_lock(&mKeyMutex);
+    EMumScheduleType previous = mMumInfo.scheduleType;
+    mMumInfo.scheduleType = scheduleType;
+    if (mMumInfo.keyInitialized)
+    {
+        // the CPU-MT workers read the current ones until PublishInfo
+        if (mMumInfo.engineType == MUM_ENGINE_TYPE_CPU_MT)
+            std::swap(mMumInfo.positionPermuteTables, mSparePositionPermuteTables);
+        if (ReserveTables(false) != MUM_ERROR_OK)
+        {
+            if (mMumInfo.engineType == MUM_ENGINE_TYPE_CPU_MT)
+                std::swap(mMumInfo.positionPermuteTables, mSparePositionPermuteTables);
+            mMumInfo.scheduleType = previous;
+            pthread_mutex_unlock(&mKeyMutex);
+            return MUM_ERROR_OUT_OF_MEMORY;
+        }
+        InitPositionPermuteTables();
+    }
+    mMumRenderer->PublishInfo();
+    pthread_mutex_unlock(&mKeyMutex);
+    return MUM_ERROR_OK;
+}
+
+EMumScheduleType CMumEngine::GetScheduleType()
+{
+    return mMumInfo.scheduleType;
 }
 
 uint32_t CMumEngine::PlaintextBlockSize()
@@ -351,6 +503,139 @@ EMumError CMumEngine::Decrypt(uint8_t *src, uint8_t *dst, uint32_t length, uint3
     return mMumRenderer->Decrypt(src, dst, length, outlength);
 }
 
+// The engines for the other block types run under mKeyMutex: a key change
+// waits for them, and they take turns.
+EMumError CMumEngine::EncryptWithBlockType(EMumBlockType blockType, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum)
+{
+    if (blockType == mMumInfo.blockType)
+        return Encrypt(src, dst, length, outlength, seqNum);
+    CMumEngine *engine;
+    pthread_mutex_lock(&mKeyMutex);
+    EMumError error = BlockTypeEngine(blockType, &engine);
+    if (error == MUM_ERROR_OK)
+        error = engine->Encrypt(src, dst, length, outlength, seqNum);
+    pthread_mutex_unlock(&mKeyMutex);
+    return error;
+}
+
+EMumError CMumEngine::DecryptWithBlockType(EMumBlockType *blockType, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength)
+{
+    if (*blockType == mMumInfo.blockType)
+        return Decrypt(src, dst, length, outlength);
+    CMumEngine *engine;
+    EMumError error = MUM_ERROR_OK;
+    pthread_mutex_lock(&mKeyMutex);
+    if (*blockType == MUM_BLOCKTYPE_INVALID)
+        error = FindBlockType(src, length, blockType);
+    if (error == MUM_ERROR_OK)
+        error = BlockTypeEngine(*blockType, &engine);
+    if (error == MUM_ERROR_OK)
+        error = engine->Decrypt(src, dst, length, outlength);
+    pthread_mutex_unlock(&mKeyMutex);
+    return error;
+}
+
+// The engine for blockType, with mKeyMutex held: this one for its own, else
+// a single-threaded one of the same padding, and of the same engine type
+// but for CPU-MT, which runs a CPU one. Those read this engine's subkeys,
+// derived once per key, and take the permute tables of whichever of them
+// has the most rows; they run the default kernel and schedule types.
+EMumError CMumEngine::BlockTypeEngine(EMumBlockType blockType, CMumEngine **engine)
+{
+    if (!mMumInfo.keyInitialized)
+        return MUM_ERROR_KEY_NOT_INITIALIZED;
+    if (blockType == mMumInfo.blockType)
+    {
+        *engine = this;
+        return MUM_ERROR_OK;
+    }
+    // GPU_B only runs 4096-byte blocks
+    if (blockType < MUM_BLOCKTYPE_128 || blockType > MUM_BLOCKTYPE_4096 || mMumInfo.engineType == MUM_ENGINE_TYPE_GPU_B)
+        return MUM_ERROR_INVALID_BLOCK_SIZE;
+
+    if (mBlockTypeEngines[blockType] == nullptr)
+    {
+        EMumEngineType engineType = mMumInfo.engineType == MUM_ENGINE_TYPE_CPU_MT ? MUM_ENGINE_TYPE_CPU : mMumInfo.engineType;
+        mBlockTypeEngines[blockType] = new CMumEngine(engineType, blockType,
+            mMumInfo.paddingOn ? MUM_PADDING_TYPE_ON : MUM_PADDING_TYPE_OFF, 1);
+        mBlockTypeEngines[blockType]->mSubkeyOwner = this;
+    }
+    CMumEngine *other = mBlockTypeEngines[blockType];
+    if (!mBlockTypeKeyed[blockType])
+    {
+        const TMumInfo *source = &mMumInfo;
+        for (uint32_t b = MUM_BLOCKTYPE_128; b <= MUM_BLOCKTYPE_4096; b++)
+        {
+            if (mBlockTypeKeyed[b] && mBlockTypeEngines[b]->mMumInfo.numRows > source->numRows)
+                source = &mBlockTypeEngines[b]->mMumInfo;
+        }
+        // on the workers of this engine, if it has any
+        InitSubkeys(false, other->mMumInfo.numRows);
+        EMumError error = other->InitKeyFromOwner(source);
+        if (error != MUM_ERROR_OK)
+            return error;
+        mBlockTypeKeyed[blockType] = true;
+    }
+    *engine = mBlockTypeEngines[blockType];
+    return MUM_ERROR_OK;
+}
+
+// The block type src was encrypted with, from its first block: its block
+// type bits and checksum only come out right when decrypted with the block
+// type it was encrypted with. Needs padding, which holds them. Of the block
+// types length allows, those with their tables set up are tried first, this
+// engine's own among them; the others then in order of setup cost, the
+// fewest rows first.
+EMumError CMumEngine::FindBlockType(uint8_t *src, uint32_t length, EMumBlockType *blockType)
+{
+    uint8_t block[MUM_MAX_BLOCK_SIZE];
+    TMumInfo info;
+    info.paddingOn = mMumInfo.paddingOn;
+    if (!mMumInfo.paddingOn)
+        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_BLOCKTYPE;
+    for (uint32_t pass = 0; pass < 2; pass++)
+    {
+        for (uint32_t b = MUM_BLOCKTYPE_128; b <= MUM_BLOCKTYPE_4096; b++)
+        {
+            bool ready = b == (uint32_t)mMumInfo.blockType || mBlockTypeKeyed[b];
+            if (ready != (pass == 0))
+                continue;
+            info.blockType = (EMumBlockType)b;
+            CMumRenderer::InitBlockGeometry(&info);
+            if (length == 0 || length % info.encryptedBlockSize != 0)
+                continue;
+            CMumEngine *engine;
+            uint32_t blockLength, seqnum;
+            if (BlockTypeEngine(info.blockType, &engine) != MUM_ERROR_OK)
+                continue;
+            if (engine->DecryptBlock(src, block, &blockLength, &seqnum) == MUM_ERROR_OK)
+            {
+                *blockType = info.blockType;
+                return MUM_ERROR_OK;
+            }
+        }
+    }
+    return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_BLOCKTYPE;
+}
+
+CMumContext *CMumEngine::CreateContext()
+{
+    if (mMumInfo.engineType != MUM_ENGINE_TYPE_CPU && mMumInfo.engineType != MUM_ENGINE_TYPE_CPU_MT &&
+        mMumInfo.engineType != MUM_ENGINE_TYPE_CPU_BITSLICE)
+        return nullptr;
+    if (!mMumInfo.keyInitialized)
+        return nullptr;
+    // stream 0 is that of the renderers, see CMumContext
+    uint32_t id = ++mNumContexts;
+    if (id == 0)
+        id = ++mNumContexts;
+    pthread_mutex_lock(&mKeyMutex);
+    for (uint32_t s = 0; s < 16; s++)
+        Subkey(MUM_PRNG_SUBKEY_INDEX + (id & 15) * 16 + s);
+    pthread_mutex_unlock(&mKeyMutex);
+    return new CMumContext(&mMumInfo, id);
+}
+
 // Return little-endian integer read from key at a specific offset. Depending on
 // the offset, this may roll-around from the end of the subkey data to the start.
 uint32_t CMumEngine::GetSubkeyInteger(uint8_t *subkey, uint32_t offset)
@@ -364,17 +649,6 @@ uint32_t CMumEngine::GetSubkeyInteger(uint8_t *subkey, uint32_t offset)
     return value;
 }
 
-void CMumEngine::InitXorTextureData()
-{
-    for (uint32_t row = 0; row < MUM_NUM_8BIT_VALUES; row++)
-    {
-        for (uint32_t col = 0; col < MUM_NUM_8BIT_VALUES; col++)
-        {
-            mMumInfo.xorTextureData[row * MUM_NUM_8BIT_VALUES + col] = (uint8_t)(row ^ col);
-        }
-    }
-}
-
 EMumError CMumEngine::EncryptBlock(uint8_t *src, uint8_t *dst, uint32_t length, uint32_t seqnum)
 {
     if (!mMumInfo.keyInitialized)
@@ -394,53 +668,56 @@ void CMumEngine::CreatePrimeCycleWithOffset(uint32_t primeIndex, uint32_t offset
     uint32_t prime = primeNumberTable[primeIndex & 255];
     for (uint32_t i = 0; i < MUM_KEY_SIZE; i++)
     {
-        outCycle[i] = mMumInfo.key[offset & MUM_KEY_MASK];
+        outCycle[i] = mMumInfo.tables->key[offset & MUM_KEY_MASK];
         offset += prime;
     }
 }
 
+// Entry n of the table is the (s % (numEntries - n))-th value not used by
+// entries 0..n-1, s read from the subkey. The unused values are counted in a
+// Fenwick tree, so finding the k-th one is a descent of log2(numEntries)
+// steps rather than a scan of the values.
 void CMumEngine::CreatePermuteTable(uint8_t *subkey, uint32_t numEntries, uint32_t *outTable)
 {
-    uint32_t used[MUM_MAX_10BIT_VALUES];
+    uint32_t unused[MUM_MAX_10BIT_VALUES + 1];
+    uint32_t topStep = 1;
 
     assert(numEntries <= MUM_MAX_10BIT_VALUES);
-    memset(used, 0, numEntries * sizeof(uint32_t));
-    memset(outTable, 0xff, numEntries * sizeof(uint32_t));
+    // all values unused: node i counts the i & -i values ending at i
+    for (uint32_t i = 1; i <= numEntries; i++)
+        unused[i] = i & (0 - i);
+    while (topStep * 2 <= numEntries)
+        topStep *= 2;
 
     uint32_t offset = 0;
-    for (uint32_t n = 0; n < numEntries - 1; n++)
+    for (uint32_t n = 0; n < numEntries; n++)
     {
-        uint32_t s = GetSubkeyInteger(subkey, offset);
-        offset += 4;
+        // the last value needs no subkey integer, it is the one left
+        uint32_t index = 0;
+        if (n < numEntries - 1)
+        {
+            uint32_t s = GetSubkeyInteger(subkey, offset);
+            offset += 4;
+            index = s % (numEntries - n);
+        }
 
-        uint32_t mod = numEntries - n;
-        uint32_t index = s % mod;
-        uint32_t m = 0;
-        assert(index < numEntries);
-        for (uint32_t p = 0; p < numEntries; p++)
+        // largest p with fewer than index + 1 unused values in 0..p-1
+        uint32_t p = 0;
+        uint32_t remaining = index + 1;
+        for (uint32_t step = topStep; step > 0; step >>= 1)
         {
-            if (used[p] == 0)
+            if (p + step <= numEntries && unused[p + step] < remaining)
             {
-                if (index == m)
-                {
-                    used[p] = 1;
-                    outTable[n] = p;
-                    break;
-                }
-                m++;
+                p += step;
+                remaining -= unused[p];
             }
         }
+        assert(p < numEntries);
+        outTable[n] = p;
+        for (uint32_t i = p + 1; i <= numEntries; i += i & (0 - i))
+            unused[i]--;
     }
 
-    // handle last value
-    for (uint32_t n = 0; n < numEntries; n++)
-    {
-        if (used[n] == 0)
-        {
-            outTable[numEntries - 1] = n;
-            used[n] = 1;
-        }
-    }
     uint32_t total = 0;
     for (uint32_t n = 0; n < numEntries; n++)
     {
@@ -451,24 +728,15 @@ void CMumEngine::CreatePermuteTable(uint8_t *subkey, uint32_t numEntries, uint32
 
 void CMumEngine::InitBitmasks()
 {
-    uint32_t row, col, index, mask, round;
+    uint32_t round;
 
     for (round = 0; round < MUM_NUM_ROUNDS; round++)
     {
         // now that we have our permuations, create the bitmasks themselves
-        mMumInfo.bitmasks[round][0] = (1 << mMumInfo.permuteTables3bit[round][0]) + (1 << mMumInfo.permuteTables3bit[round][1]);
-        mMumInfo.bitmasks[round][1] = (1 << mMumInfo.permuteTables3bit[round][2]) + (1 << mMumInfo.permuteTables3bit[round][3]);
-        mMumInfo.bitmasks[round][2] = (1 << mMumInfo.permuteTables3bit[round][4]) + (1 << mMumInfo.permuteTables3bit[round][5]);
-        mMumInfo.bitmasks[round][3] = (1 << mMumInfo.permuteTables3bit[round][6]) + (1 << mMumInfo.permuteTables3bit[round][7]);
-        for (row = 0; row < MUM_MASK_TABLE_ROWS; row++)
-        {
-            index = row / 8;
-            mask = mMumInfo.bitmasks[round][index];
-            for (col = 0; col < MUM_NUM_8BIT_VALUES; col++)
-            {
-                mMumInfo.bitmaskTextureData[round][row * MUM_NUM_8BIT_VALUES + col] = (uint8_t)(col & mask);
-            }
-        }
+        mMumInfo.tables->bitmasks[round][0] = (1 << mMumInfo.tables->permuteTables3bit[round][0]) + (1 << mMumInfo.tables->permuteTables3bit[round][1]);
+        mMumInfo.tables->bitmasks[round][1] = (1 << mMumInfo.tables->permuteTables3bit[round][2]) + (1 << mMumInfo.tables->permuteTables3bit[round][3]);
+        mMumInfo.tables->bitmasks[round][2] = (1 << mMumInfo.tables->permuteTables3bit[round][4]) + (1 << mMumInfo.tables->permuteTables3bit[round][5]);
+        mMumInfo.tables->bitmasks[round][3] = (1 << mMumInfo.tables->permuteTables3bit[round][6]) + (1 << mMumInfo.tables->permuteTables3bit[round][7]);
     }
 }
 
@@ -479,7 +747,6 @@ void CMumEngine::InitPositionTables()
     uint32_t position, value;
     uint32_t numRows = mMumInfo.numRows;
 
-    uint32_t textureScalar = 4096 / mMumInfo.plaintextBlockSize;
     for (round = 0; round < MUM_NUM_ROUNDS; round++)
     {
         for (n = 0; n < numRows * MUM_CELLS_X; n++)
@@ -489,93 +756,601 @@ void CMumEngine::InitPositionTables()
             for (position = 0; position < MUM_NUM_POSITIONS; position++)
             {
                 // index = (n * primes[position]) % (numRows*MUM_CELLS_X);
-                value = mMumInfo.permuteTables10bit[round][position][n];
+                value = mMumInfo.tables->permuteTables10bit[round][position][n];
                 mapX = value % MUM_CELLS_X;
                 mapY = value / MUM_CELLS_X;
-                mMumInfo.positionTables5bitX[round][y][x][position] = mapX;
-                mMumInfo.positionTables5bitY[round][y][x][position] = mapY;
-                mMumInfo.positionTables5bitXI[round][mapY][mapX][position] = x;
-                mMumInfo.positionTables5bitYI[round][mapY][mapX][position] = y;
-                mMumInfo.positionTextureDataX[round][y][x][position] = (uint8_t)(mapX * 8 + 4);
-                mMumInfo.positionTextureDataY[round][y][x][position] = (uint8_t)(mapY * 8 * textureScalar + 4 * textureScalar);
-                mMumInfo.positionTextureDataYB[round][y][x][position] = (uint8_t)(mapY + round * numRows);
-                mMumInfo.positionTextureDataXI[round][mapY][mapX][position] = (uint8_t)(x * 8 + 4);
-                mMumInfo.positionTextureDataYI[round][mapY][mapX][position] = (uint8_t)(y * 8 * textureScalar + 4 * textureScalar);
-                mMumInfo.positionTextureDataYIB[round][mapY][mapX][position] = (uint8_t)(y + (7 - round) * numRows);
+                mMumInfo.tables->positionTables5bitX[round][y][x][position] = mapX;
+                mMumInfo.tables->positionTables5bitY[round][y][x][position] = mapY;
+                mMumInfo.tables->positionTables5bitXI[round][mapY][mapX][position] = x;
+                mMumInfo.tables->positionTables5bitYI[round][mapY][mapX][position] = y;
             }
         }
     }
 }
 
-void CMumEngine::InitSubkeys()
+// the tables of the GPU renderers, as texture data
+void CMumEngine::InitTextureData()
 {
-    uint8_t cycles[MUM_NUM_CYCLES][MUM_KEY_SIZE];
-    uint32_t offset = 0;
-    uint32_t index = 0;
-    for (uint32_t s = 0; s < MUM_NUM_SUBKEYS; s++)
+    uint32_t n, round, row, col, x, y, position;
+    uint32_t numRows = mMumInfo.numRows;
+    uint32_t textureScalar = 4096 / mMumInfo.plaintextBlockSize;
+    TMumTextureData *textureData = mMumInfo.textureData;
+
+    for (round = 0; round < MUM_NUM_ROUNDS; round++)
     {
-        uint8_t *pcycles[MUM_NUM_CYCLES];
-        for (uint32_t i = 0; i < MUM_NUM_CYCLES; i++)
+        for (row = 0; row < MUM_MASK_TABLE_ROWS; row++)
+        {
+            uint32_t mask = mMumInfo.tables->bitmasks[round][row / 8];
+            for (col = 0; col < MUM_NUM_8BIT_VALUES; col++)
+            {
+                textureData->bitmaskTextureData[round][row * MUM_NUM_8BIT_VALUES + col] = (uint8_t)(col & mask);
+            }
+        }
+        for (y = 0; y < numRows; y++)
         {
-            pcycles[i] = cycles[i];
-            CreatePrimeCycleWithOffset(index, offset, pcycles[i]);
-            index += MUM_CYCLE_INDEX_INCREMENT;
-            offset += MUM_CYCLE_OFFSET_INCREMENT;
+            for (n = 0; n < MUM_NUM_8BIT_VALUES; n++)
+            {
+                textureData->permuteTextureData[round][y][n] = (uint8_t)mMumInfo.tables->permuteTables8bit[round][y][n];
+                textureData->permuteTextureDataI[round][y][n] = (uint8_t)mMumInfo.tables->permuteTables8bitI[round][y][n];
+            }
         }
-        uint8_t *subkey = mMumInfo.subkeys[s];
-        for (uint32_t i = 0; i < MUM_KEY_SIZE; i++)
+        for (n = 0; n < numRows * MUM_CELLS_X; n++)
+        {
+            x = n % MUM_CELLS_X;
+            y = n / MUM_CELLS_X;
+            for (position = 0; position < MUM_NUM_POSITIONS; position++)
+            {
+                uint32_t mapX = mMumInfo.tables->positionTables5bitX[round][y][x][position];
+                uint32_t mapY = mMumInfo.tables->positionTables5bitY[round][y][x][position];
+                uint32_t mapXI = mMumInfo.tables->positionTables5bitXI[round][y][x][position];
+                uint32_t mapYI = mMumInfo.tables->positionTables5bitYI[round][y][x][position];
+                textureData->positionTextureDataX[round][y][x][position] = (uint8_t)(mapX * 8 + 4);
+                textureData->positionTextureDataY[round][y][x][position] = (uint8_t)(mapY * 8 * textureScalar + 4 * textureScalar);
+                textureData->positionTextureDataYB[round][y][x][position] = (uint8_t)(mapY + round * numRows);
+                textureData->positionTextureDataXI[round][y][x][position] = (uint8_t)(mapXI * 8 + 4);
+                textureData->positionTextureDataYI[round][y][x][position] = (uint8_t)(mapYI * 8 * textureScalar + 4 * textureScalar);
+                textureData->positionTextureDataYIB[round][y][x][position] = (uint8_t)(mapYI + (7 - round) * numRows);
+            }
+        }
+    }
+}
+
+// Subkey s is the XOR of MUM_NUM_CYCLES prime cycles of the key, at a cycle
+// index and offset that only depend on s, so each is derived on its own.
+uint8_t *CMumEngine::Subkey(uint32_t s)
+{
+    if (mSubkeyOwner != nullptr)
+        return mSubkeyOwner->Subkey(s);
+    if (mMumInfo.tables->subkeyValid[s])
+        return mMumInfo.tables->subkeys[s];
+
+    uint32_t index = s * MUM_NUM_CYCLES * MUM_CYCLE_INDEX_INCREMENT;
+    uint32_t offset = s * MUM_NUM_CYCLES * MUM_CYCLE_OFFSET_INCREMENT;
+#ifdef USE_SIMD
+    static const bool useAvx2 = MumKernelTypeSupported(MUM_KERNEL_TYPE_AVX2, mMumInfo.blockType);
+    if (useAvx2)
+    {
+        uint32_t primes[MUM_NUM_CYCLES];
+        uint32_t offsets[MUM_NUM_CYCLES];
+        for (uint32_t i = 0; i < MUM_NUM_CYCLES; i++)
         {
-            uint8_t value = *pcycles[0]++;
-            for (uint32_t i = 1; i < MUM_NUM_CYCLES; i++)
-                value ^= *pcycles[i]++;
-            *subkey++ = value;
+            primes[i] = primeNumberTable[(index + i * MUM_CYCLE_INDEX_INCREMENT) & 255];
+            offsets[i] = offset + i * MUM_CYCLE_OFFSET_INCREMENT;
         }
+        MumXorPrimeCyclesAvx2(mMumInfo.tables->key, primes, offsets, mMumInfo.tables->subkeys[s]);
+        mMumInfo.tables->subkeyValid[s] = true;
+        return mMumInfo.tables->subkeys[s];
+    }
+#endif
+
+    uint8_t cycles[MUM_NUM_CYCLES][MUM_KEY_SIZE];
+    uint8_t *pcycles[MUM_NUM_CYCLES];
+    for (uint32_t i = 0; i < MUM_NUM_CYCLES; i++)
+    {
+        pcycles[i] = cycles[i];
+        CreatePrimeCycleWithOffset(index, offset, pcycles[i]);
+        index += MUM_CYCLE_INDEX_INCREMENT;
+        offset += MUM_CYCLE_OFFSET_INCREMENT;
     }
+    uint8_t *subkey = mMumInfo.tables->subkeys[s];
+    for (uint32_t i = 0; i < MUM_KEY_SIZE; i++)
+    {
+        uint8_t value = *pcycles[0]++;
+        for (uint32_t i = 1; i < MUM_NUM_CYCLES; i++)
+            value ^= *pcycles[i]++;
+        *subkey++ = value;
+    }
+    mMumInfo.tables->subkeyValid[s] = true;
+    return mMumInfo.tables->subkeys[s];
+}
+
+typedef struct TMumSubkeyTask
+{
+    CMumEngine *engine;
+    uint32_t numSubkeys;
+    uint32_t subkeys[MUM_NUM_SUBKEYS];
+} TMumSubkeyTask;
+
+void CMumEngine::DeriveSubkeys(void *param, uint32_t part, uint32_t numParts)
+{
+    TMumSubkeyTask *task = (TMumSubkeyTask *)param;
+    for (uint32_t i = part; i < task->numSubkeys; i += numParts)
+        task->engine->Subkey(task->subkeys[i]);
 }
 
-void CMumEngine::InitPermuteTables()
+// Derives up front, on the worker threads of the renderer if it has any,
+// the subkeys read during key setup and by the renderers: those of the
+// confuse, bitmask, 8-bit and 10-bit permute tables, the PRNG sets of the
+// renderer and the CPU-MT threads, and all of them for the GPU engines or
+// with allSubkeys.
+void CMumEngine::InitSubkeys(bool allSubkeys)
+{
+    InitSubkeys(allSubkeys, mMumInfo.numRows);
+}
+
+// as above for the tables of a block type with numRows rows
+void CMumEngine::InitSubkeys(bool allSubkeys, uint32_t numRows)
+{
+    TMumSubkeyTask task;
+    task.engine = this;
+    task.numSubkeys = 0;
+
+    uint32_t numTableSubkeys = MUM_NUM_ROUNDS * (2 + numRows + MUN_NUM_POSITIONS);
+    for (uint32_t s = 0; s < MUM_NUM_SUBKEYS; s++)
+    {
+        bool used = allSubkeys || mMumInfo.textureData != nullptr || s < numTableSubkeys ||
+            (s >= MUM_PRNG_SUBKEY_INDEX && s < MUM_PRNG_SUBKEY_INDEX + mNumPrngSets * 16);
+        if (used && !SubkeyTables()->subkeyValid[s])
+            task.subkeys[task.numSubkeys++] = s;
+    }
+    if (task.numSubkeys > 0)
+        mMumRenderer->RunParallel(DeriveSubkeys, &task);
+}
+
+// source, if not null, is the key set up for another block type: a 3-bit or
+// 8-bit table depends on its subkey only, so those it has are copied
+void CMumEngine::InitPermuteTables(const TMumInfo *source)
 {
     uint32_t round, y, n;
     uint32_t numRows = mMumInfo.numRows;
     // first eight subkeys used for confusion pass.
     uint32_t subkeyIndex = 8;
+    TMumKeyTables *tables = mMumInfo.tables;
 
     for (round = 0; round < MUM_NUM_ROUNDS; round++)
     {
-        CreatePermuteTable(mMumInfo.subkeys[subkeyIndex++], MUM_NUM_3BIT_VALUES, mMumInfo.permuteTables3bit[round]);
+        if (source != nullptr)
+            memcpy(tables->permuteTables3bit[round], source->tables->permuteTables3bit[round], sizeof(tables->permuteTables3bit[round]));
+        else
+            CreatePermuteTable(Subkey(subkeyIndex), MUM_NUM_3BIT_VALUES, tables->permuteTables3bit[round]);
+        subkeyIndex++;
     }
 
     for (round = 0; round < MUM_NUM_ROUNDS; round++)
     {
         for (y = 0; y < numRows; y++)
         {
-            CreatePermuteTable(mMumInfo.subkeys[subkeyIndex++], MUM_NUM_8BIT_VALUES, mMumInfo.permuteTables8bit[round][y]);
-            for (n = 0; n < MUM_NUM_8BIT_VALUES; n++)
-                mMumInfo.permuteTables8bitI[round][y][mMumInfo.permuteTables8bit[round][y][n]] = n;
-            for (n = 0; n < MUM_NUM_8BIT_VALUES; n++)
+            // the table of this subkey in source
+            uint32_t index = round * numRows + y;
+            if (source != nullptr && index < MUM_NUM_ROUNDS * source->numRows)
             {
-                mMumInfo.permuteTextureData[round][y][n] = (uint8_t)mMumInfo.permuteTables8bit[round][y][n];
-                mMumInfo.permuteTextureDataI[round][y][n] = (uint8_t)mMumInfo.permuteTables8bitI[round][y][n];
+                uint32_t sourceRound = index / source->numRows;
+                uint32_t sourceY = index % source->numRows;
+                memcpy(tables->permuteTables8bit[round][y], source->tables->permuteTables8bit[sourceRound][sourceY], sizeof(tables->permuteTables8bit[round][y]));
+                memcpy(tables->permuteTables8bitI[round][y], source->tables->permuteTables8bitI[sourceRound][sourceY], sizeof(tables->permuteTables8bitI[round][y]));
+                subkeyIndex++;
+                continue;
             }
+            CreatePermuteTable(Subkey(subkeyIndex++), MUM_NUM_8BIT_VALUES, tables->permuteTables8bit[round][y]);
+            for (n = 0; n < MUM_NUM_8BIT_VALUES; n++)
+                tables->permuteTables8bitI[round][y][tables->permuteTables8bit[round][y][n]] = n;
         }
     }
 
     for (round = 0; round < MUM_NUM_ROUNDS; round++)
     {
         for (uint32_t position = 0; position < MUN_NUM_POSITIONS; position++)
-            CreatePermuteTable(mMumInfo.subkeys[subkeyIndex++], numRows * MUM_CELLS_X, mMumInfo.permuteTables10bit[round][position]);
+            CreatePermuteTable(Subkey(subkeyIndex++), numRows * MUM_CELLS_X, mMumInfo.tables->permuteTables10bit[round][position]);
+    }
+
+    InitPositionPermuteTables();
+}
+
+void CMumEngine::InitPositionPermuteTables()
+{
+    uint32_t round, n, v;
+    uint32_t blockSize = mMumInfo.encryptedBlockSize;
+    uint32_t tableSize = blockSize * MUM_NUM_8BIT_VALUES;
+
+    if (mMumInfo.scheduleType != MUM_SCHEDULE_TYPE_POSITION_TABLES)
+    {
+        MumFree(mMumInfo.positionPermuteTables);
+        mMumInfo.positionPermuteTables = nullptr;
+        for (round = 0; round < MUM_NUM_ROUNDS; round++)
+        {
+            mMumInfo.positionPermute[round] = nullptr;
+            mMumInfo.positionPermuteI[round] = nullptr;
+        }
+        return;
+    }
+
+    // allocated by ReserveTables
+    for (round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        // confuse of round uses subkeys[round], see InitSchedule
+        uint8_t *subkey = Subkey(round);
+        uint8_t *permute = mMumInfo.positionPermuteTables + 2 * round * tableSize;
+        uint8_t *permuteI = permute + tableSize;
+        for (n = 0; n < blockSize; n++)
+        {
+            uint32_t y = n / (MUM_CELLS_X * MUM_CELL_SIZE);
+            uint8_t key = subkey[n];
+            for (v = 0; v < MUM_NUM_8BIT_VALUES; v++)
+            {
+                permute[n * MUM_NUM_8BIT_VALUES + v] = (uint8_t)mMumInfo.tables->permuteTables8bit[round][y][v ^ key];
+                permuteI[n * MUM_NUM_8BIT_VALUES + v] = (uint8_t)mMumInfo.tables->permuteTables8bitI[round][y][v] ^ key;
+            }
+        }
+        mMumInfo.positionPermute[round] = permute;
+        mMumInfo.positionPermuteI[round] = permuteI;
+    }
+}
+
+void CMumEngine::InitSchedule()
+{
+    uint32_t round, n, position, y;
+    uint32_t numCells = mMumInfo.numRows * MUM_CELLS_X;
+
+    for (round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        TMumRoundSchedule *schedule = &mMumInfo.tables->schedule[round];
+        for (position = 0; position < MUM_NUM_POSITIONS; position++)
+            schedule->bitmasks[position] = (uint8_t)mMumInfo.tables->bitmasks[round][position];
+        memcpy(schedule->subkey, Subkey(round), MUM_MAX_BLOCK_SIZE);
+        for (n = 0; n < numCells; n++)
+        {
+            uint32_t x = n % MUM_CELLS_X;
+            y = n / MUM_CELLS_X;
+            for (position = 0; position < MUM_NUM_POSITIONS; position++)
+            {
+                schedule->gather[n][position] = (uint16_t)(MUM_CELL_SIZE *
+                    (mMumInfo.tables->positionTables5bitY[round][y][x][position] * MUM_CELLS_X + mMumInfo.tables->positionTables5bitX[round][y][x][position]));
+                schedule->gatherI[n][position] = (uint16_t)(MUM_CELL_SIZE *
+                    (mMumInfo.tables->positionTables5bitYI[round][y][x][position] * MUM_CELLS_X + mMumInfo.tables->positionTables5bitXI[round][y][x][position]));
+            }
+        }
+        for (y = 0; y < mMumInfo.numRows; y++)
+        {
+            for (n = 0; n < MUM_NUM_8BIT_VALUES; n++)
+            {
+                schedule->permute[y][n] = (uint8_t)mMumInfo.tables->permuteTables8bit[round][y][n];
+                schedule->permuteI[y][n] = (uint8_t)mMumInfo.tables->permuteTables8bitI[round][y][n];
+            }
+        }
     }
 }
 
 EMumError CMumEngine::InitKey(uint8_t *key)
 {
-    memcpy(mMumInfo.key, key, MUM_KEY_SIZE);
-    InitSubkeys();
-    InitPermuteTables();
+    CMumKeyCache *keyCache = CMumKeyCache::Instance();
+    BeginKeyChange();
+    TMumKeyCacheEntry *entry = keyCache->Acquire(key, &mMumInfo);
+    if (entry != nullptr)
+    {
+        mKeyCacheEntry = entry;
+        return AttachTables(entry->tables, entry->positionPermuteTables);
+    }
+
+    EMumError error = ReserveTables(true);
+    if (error != MUM_ERROR_OK)
+    {
+        AbortKeyChange();
+        return error;
+    }
+    UseOwnTables();
+    memcpy(mMumInfo.tables->key, key, MUM_KEY_SIZE);
+    memset(mMumInfo.tables->subkeyValid, 0, sizeof(mMumInfo.tables->subkeyValid));
+    InitSubkeys(false);
+    InitTables(nullptr);
+    if (mMumInfo.textureData != nullptr)
+        InitTextureData();
+    // an entry is attached read-only by other engines, so it holds every
+    // subkey; the tables are then the entry's
+    if (keyCache->Accepts(&mMumInfo))
+    {
+        InitSubkeys(true);
+        mKeyCacheEntry = keyCache->Store(&mMumInfo);
+        if (mKeyCacheEntry != nullptr)
+            mOwnTables = nullptr;
+    }
+    ActivateKey();
+    return MUM_ERROR_OK;
+}
+
+// the key tables after the subkeys; source as for InitPermuteTables
+void CMumEngine::InitTables(const TMumInfo *source)
+{
+    InitPermuteTables(source);
     InitPositionTables();
     InitBitmasks();
-    mMumRenderer->InitKey();
+    InitSchedule();
+    if (mMumInfo.blockType == MUM_BLOCKTYPE_128)
+        MumInitVbmiTables(&mMumInfo);
+}
+
+// the rest of key setup once the tables are in place, however they got there
+void CMumEngine::ActivateKey()
+{
+    // an entry built by another engine type may lack PRNG sets
+    InitSubkeys(false);
+    mMumInfo.subkeys = SubkeyTables()->subkeys;
+    // code for the previous key was retired by BeginKeyChange
+    if (mMumInfo.kernelMode == MUM_KERNEL_MODE_JIT)
+        MumJitBuild(&mMumInfo);
+    MumSelectCpuKernels(&mMumInfo);
     mMumInfo.keyInitialized = true;
+    mMumRenderer->InitKey();
+    for (uint32_t b = 0; b <= MUM_BLOCKTYPE_4096; b++)
+        mBlockTypeKeyed[b] = false;
+    EndKeyChange();
+}
+
+// Starts a key change. Nothing the current key uses is freed or rewritten
+// until the renderer has the new one: on CPU-MT the workers keep running
+// jobs under the current key while the next one is set up, in the spare
+// tables, and InitKey hands it to them between jobs. Ends with
+// ActivateKey.
+void CMumEngine::BeginKeyChange()
+{
+    pthread_mutex_lock(&mKeyMutex);
+    mRetiredSharedTables = mSharedTables;
+    mSharedTables.map = nullptr;
+    mRetiredKeyStore = mKeyStore;
+    mRetiredKeyStoreEntry = mKeyStoreEntry;
+    mKeyStore = nullptr;
+    mKeyStoreEntry = nullptr;
+    mRetiredKeyCacheEntry = mKeyCacheEntry;
+    mKeyCacheEntry = nullptr;
+    mRetiredJitCode = mMumInfo.jitCode;
+    mMumInfo.jitCode = nullptr;
+    if (mMumInfo.engineType == MUM_ENGINE_TYPE_CPU_MT)
+    {
+        std::swap(mOwnTables, mSpareTables);
+        std::swap(mMumInfo.positionPermuteTables, mSparePositionPermuteTables);
+    }
+}
+
+void CMumEngine::EndKeyChange()
+{
+    if (mRetiredSharedTables.map != nullptr)
+        MumUnmapScheduleFile(&mRetiredSharedTables);
+    if (mRetiredKeyStoreEntry != nullptr)
+        mRetiredKeyStore->Release(mRetiredKeyStoreEntry);
+    mRetiredKeyStore = nullptr;
+    mRetiredKeyStoreEntry = nullptr;
+    if (mRetiredKeyCacheEntry != nullptr)
+        CMumKeyCache::Instance()->Release(mRetiredKeyCacheEntry);
+    mRetiredKeyCacheEntry = nullptr;
+    MumJitFreeCode(mRetiredJitCode);
+    mRetiredJitCode = nullptr;
+    // an attached schedule needs no own tables to swap with
+    if (mOwnTables == nullptr)
+    {
+        MumFree(mSpareTables);
+        mSpareTables = nullptr;
+    }
+    if (mMumInfo.positionPermuteTables == nullptr)
+    {
+        MumFree(mSparePositionPermuteTables);
+        mSparePositionPermuteTables = nullptr;
+    }
+    pthread_mutex_unlock(&mKeyMutex);
+}
+
+// gives up a key change before anything of the current key was replaced:
+// what the change attached is released, and the rest BeginKeyChange did is
+// undone
+void CMumEngine::AbortKeyChange()
+{
+    DetachTables();
+    mSharedTables = mRetiredSharedTables;
+    mRetiredSharedTables.map = nullptr;
+    mKeyStore = mRetiredKeyStore;
+    mKeyStoreEntry = mRetiredKeyStoreEntry;
+    mRetiredKeyStore = nullptr;
+    mRetiredKeyStoreEntry = nullptr;
+    mKeyCacheEntry = mRetiredKeyCacheEntry;
+    mRetiredKeyCacheEntry = nullptr;
+    mMumInfo.jitCode = mRetiredJitCode;
+    mRetiredJitCode = nullptr;
+    if (mMumInfo.engineType == MUM_ENGINE_TYPE_CPU_MT)
+    {
+        std::swap(mOwnTables, mSpareTables);
+        std::swap(mMumInfo.positionPermuteTables, mSparePositionPermuteTables);
+    }
+    pthread_mutex_unlock(&mKeyMutex);
+}
+
+EMumError CMumEngine::SaveKeySchedule(const char *schedulefile)
+{
+    if (!mMumInfo.keyInitialized)
+        return MUM_ERROR_KEY_NOT_INITIALIZED;
+    // the file serves every engine type, so it holds all subkeys
+    pthread_mutex_lock(&mKeyMutex);
+    InitSubkeys(true);
+    pthread_mutex_unlock(&mKeyMutex);
+    return MumWriteScheduleFile(&mMumInfo, schedulefile);
+}
+
+EMumError CMumEngine::LoadKeySchedule(const char *schedulefile)
+{
+    TMumScheduleFile scheduleFile;
+    EMumError error = MumMapScheduleFile(&mMumInfo, schedulefile, &scheduleFile);
+    if (error != MUM_ERROR_OK)
+        return error;
+    // attached as a shared schedule is, until the next key change
+    BeginKeyChange();
+    mSharedTables = scheduleFile;
+    return AttachTables((TMumKeyTables *)scheduleFile.tables, scheduleFile.positionPermuteTables);
+}
+
+EMumError CMumEngine::InitSharedKey(uint8_t *key, const char *name)
+{
+    TMumScheduleFile shared;
+    TMumKeyTables *tables;
+    EMumError error = MumMapSharedSchedule(&mMumInfo, key, name, &shared);
+    if (error == MUM_ERROR_SHAREDKEY_NAME)
+        return error;
+    if (error == MUM_ERROR_OK)
+    {
+        BeginKeyChange();
+        mSharedTables = shared;
+        return AttachTables((TMumKeyTables *)shared.tables, nullptr);
+    }
+    if (error == MUM_ERROR_SHAREDKEY_NOT_FOUND)
+    {
+        BeginKeyChange();
+        error = ReserveTables(false);
+        if (error == MUM_ERROR_OK && MumCreateSharedSchedule(&mMumInfo, name, &shared, &tables) == MUM_ERROR_OK)
+            return PublishSharedKey(key, &shared, tables);
+        AbortKeyChange();
+        if (error != MUM_ERROR_OK)
+            return error;
+    }
+    // no shared memory, or a segment still being written
+    error = InitKey(key);
+    return error != MUM_ERROR_OK ? error : MUM_ERROR_SHAREDKEY_PRIVATE;
+}
+
+// The first process with a key publishes it, expanded in place with all
+// subkeys as the attached engines cannot derive any; after BeginKeyChange.
+EMumError CMumEngine::PublishSharedKey(uint8_t *key, TMumScheduleFile *shared, TMumKeyTables *tables)
+{
+    MumFree(mOwnTables);
+    mOwnTables = nullptr;
+    mMumInfo.tables = tables;
+    memcpy(tables->key, key, MUM_KEY_SIZE);
+    InitSubkeys(true);
+    InitTables(nullptr);
+    MumCompleteSharedSchedule(&mMumInfo, shared);
+    mSharedTables = *shared;
+    if (mMumInfo.textureData != nullptr)
+        InitTextureData();
+    ActivateKey();
+    return MUM_ERROR_OK;
+}
+
+EMumError CMumEngine::InitStoreKey(CMumKeyStore *keyStore, uint32_t keyId)
+{
+    if (keyStore->BlockType() != mMumInfo.blockType)
+        return MUM_ERROR_KEYSTORE_BLOCKTYPE;
+    TMumKeyStoreEntry *entry;
+    EMumError error = keyStore->Acquire(keyId, &entry);
+    if (error != MUM_ERROR_OK)
+        return error;
+    BeginKeyChange();
+    mKeyStore = keyStore;
+    mKeyStoreEntry = entry;
+    return AttachTables(entry->tables, nullptr);
+}
+
+// Expands key into tables, all subkeys derived, for a key store; the engine
+// itself is left without a key.
+EMumError CMumEngine::ExpandKey(uint8_t *key, TMumKeyTables *tables)
+{
+    if (ReserveTables(false) != MUM_ERROR_OK)
+        return MUM_ERROR_OUT_OF_MEMORY;
+    mMumInfo.keyInitialized = false;
+    mMumInfo.tables = tables;
+    memcpy(tables->key, key, MUM_KEY_SIZE);
+    memset(tables->subkeyValid, 0, sizeof(tables->subkeyValid));
+    InitSubkeys(true);
+    InitTables(nullptr);
+    mMumInfo.tables = mOwnTables;
+    return MUM_ERROR_OK;
+}
+
+// the tables holding the subkeys: those of mSubkeyOwner if set
+TMumKeyTables *CMumEngine::SubkeyTables()
+{
+    return mSubkeyOwner != nullptr ? mSubkeyOwner->mMumInfo.tables : mMumInfo.tables;
+}
+
+// Allocates what a key change builds in, the position tables and with
+// ownTables the engine's own tables, before anything of the current key is
+// replaced; MUM_ERROR_OUT_OF_MEMORY then leaves it to AbortKeyChange.
+EMumError CMumEngine::ReserveTables(bool ownTables)
+{
+    bool positionTables = mMumInfo.scheduleType == MUM_SCHEDULE_TYPE_POSITION_TABLES;
+    if (positionTables && mMumInfo.positionPermuteTables == nullptr)
+        mMumInfo.positionPermuteTables = (uint8_t *)MumAllocHugePages(MumPositionTablesSize(&mMumInfo));
+    if (ownTables && mOwnTables == nullptr)
+        mOwnTables = (TMumKeyTables *)MumAlloc(sizeof(TMumKeyTables));
+    if ((positionTables && mMumInfo.positionPermuteTables == nullptr) || (ownTables && mOwnTables == nullptr))
+        return MUM_ERROR_OUT_OF_MEMORY;
+    return MUM_ERROR_OK;
+}
+
+// points mMumInfo at the engine's own tables, once reserved
+void CMumEngine::UseOwnTables()
+{
+    mMumInfo.tables = mOwnTables;
+}
+
+void CMumEngine::DetachTables()
+{
+    if (mSharedTables.map != nullptr)
+        MumUnmapScheduleFile(&mSharedTables);
+    if (mKeyStoreEntry != nullptr)
+        mKeyStore->Release(mKeyStoreEntry);
+    mKeyStore = nullptr;
+    mKeyStoreEntry = nullptr;
+    if (mKeyCacheEntry != nullptr)
+        CMumKeyCache::Instance()->Release(mKeyCacheEntry);
+    mKeyCacheEntry = nullptr;
+}
+
+// tables of a shared schedule or schedule file, a key store or the key
+// cache, read-only: every subkey is derived, so nothing writes to them. The
+// position tables are copied from positionPermuteTables if given, else
+// built. After BeginKeyChange, which is given up if the position tables
+// cannot be had.
+EMumError CMumEngine::AttachTables(TMumKeyTables *tables, const uint8_t *positionPermuteTables)
+{
+    EMumError error = ReserveTables(false);
+    if (error != MUM_ERROR_OK)
+    {
+        AbortKeyChange();
+        return error;
+    }
+    mMumInfo.tables = tables;
+    MumFree(mOwnTables);
+    mOwnTables = nullptr;
+    MumCopyPositionTables(&mMumInfo, positionPermuteTables);
+    if (mMumInfo.positionPermute[0] == nullptr)
+        InitPositionPermuteTables();
+    if (mMumInfo.textureData != nullptr)
+        InitTextureData();
+    ActivateKey();
+    return MUM_ERROR_OK;
+}
+
+// the key of mSubkeyOwner, whose subkeys are read in place, for this block
+// type; the permute tables of source are copied
+EMumError CMumEngine::InitKeyFromOwner(const TMumInfo *source)
+{
+    BeginKeyChange();
+    EMumError error = ReserveTables(true);
+    if (error != MUM_ERROR_OK)
+    {
+        AbortKeyChange();
+        return error;
+    }
+    UseOwnTables();
+    InitTables(source);
+    if (mMumInfo.textureData != nullptr)
+        InitTextureData();
+    ActivateKey();
     return MUM_ERROR_OK;
 }
 
@@ -601,6 +1376,8 @@ EMumError CMumEngine::GetSubkey(uint32_t index, uint8_t *subkey)
         return MUM_ERROR_KEY_NOT_INITIALIZED;
     if (index >= MUM_NUM_SUBKEYS)
         return MUM_ERROR_SUBKEY_INDEX_OUTOFRANGE;
-    memcpy(subkey, mMumInfo.subkeys[index], MUM_KEY_SIZE);
+    pthread_mutex_lock(&mKeyMutex);
+    memcpy(subkey, Subkey(index), MUM_KEY_SIZE);
+    pthread_mutex_unlock(&mKeyMutex);
     return MUM_ERROR_OK;
 }
@@ -0,0 +1,65 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumfused.h"
+#include "mumsimd.h"
+
+void MumEncryptRoundsFused(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1)
+{
+#ifdef USE_SIMD
+    if (mumInfo->kernelType == MUM_KERNEL_TYPE_AVX2)
+    {
+        uint8_t *work[2] = {work0, work1};
+        for (uint32_t round = 0; round < MUM_NUM_ROUNDS; round++)
+        {
+            uint8_t *out = (round == MUM_NUM_ROUNDS - 1) ? dst : work[round & 1];
+            MumEncryptRoundFusedAvx2(mumInfo, round, src, out);
+            src = out;
+        }
+        return;
+    }
+#endif
+    mumInfo->encryptFusedScalar(mumInfo, src, dst, work0, work1);
+}
+
+void MumDecryptRoundsFused(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1)
+{
+#ifdef USE_SIMD
+    if (mumInfo->kernelType == MUM_KERNEL_TYPE_AVX2)
+    {
+        uint8_t *work[2] = {work0, work1};
+        // the inverse confuse of the last round has no diffuse pass before it
+        MumDecryptConfuseAvx2(mumInfo, MUM_NUM_ROUNDS - 1, src, work0);
+        src = work0;
+        for (int round = MUM_NUM_ROUNDS - 1; round >= 0; round--)
+        {
+            uint8_t *out = (round == 0) ? dst : work[(MUM_NUM_ROUNDS - round) & 1];
+            MumDecryptRoundFusedAvx2(mumInfo, (uint32_t)round, src, out);
+            src = out;
+        }
+        return;
+    }
+#endif
+    mumInfo->decryptFusedScalar(mumInfo, src, dst, work0, work1);
+}
@@ -0,0 +1,199 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumjit.h"
+#include "mumsimd.h"
+#include <string.h>
+#if defined(USE_JIT) && defined(__x86_64__)
+#include <sys/mman.h>
+#define MUM_JIT_X86_64
+#endif
+
+#ifdef MUM_JIT_X86_64
+
+// With a null buffer the emitter only counts bytes, so the region can be
+// sized before it is mapped.
+typedef struct TMumJitEmitter
+{
+    uint8_t *buffer;
+    size_t size;
+} TMumJitEmitter;
+
+static inline void Emit(TMumJitEmitter *e, uint8_t byte)
+{
+    if (e->buffer)
+        e->buffer[e->size] = byte;
+    e->size++;
+}
+
+// Both pointers are biased by 128 on entry, so that offsets 0 to 255 take
+// an 8-bit displacement (mod 01); the rest take 32 bits (mod 10).
+#define MUM_JIT_BIAS 128
+
+static void EmitDisp(TMumJitEmitter *e, uint8_t modrm, uint32_t offset)
+{
+    int32_t disp = (int32_t)offset - MUM_JIT_BIAS;
+    if (disp >= -128 && disp < 128)
+    {
+        Emit(e, (uint8_t)(0x40 | modrm));
+        Emit(e, (uint8_t)disp);
+    }
+    else
+    {
+        Emit(e, (uint8_t)(0x80 | modrm));
+        for (uint32_t i = 0; i < 4; i++)
+            Emit(e, (uint8_t)((uint32_t)disp >> (8 * i)));
+    }
+}
+
+// movzx reg, byte [rdi + disp]; and reg, mask; reg is eax (0) or ecx (1)
+static void EmitLoadMasked(TMumJitEmitter *e, uint32_t reg, uint32_t disp, uint8_t mask)
+{
+    Emit(e, 0x0F);
+    Emit(e, 0xB6);
+    EmitDisp(e, (uint8_t)((reg << 3) | 7), disp);
+    // 83 /4 ib sign extends the mask; only the low byte is stored
+    Emit(e, 0x83);
+    Emit(e, (uint8_t)(0xE0 | reg));
+    Emit(e, mask);
+}
+
+static void EmitDiffuse(TMumJitEmitter *e, uint32_t numCells, const uint16_t *gather, const uint8_t *bitmasks,
+                        const uint8_t sourceBytes[MUM_NUM_POSITIONS][MUM_CELL_SIZE])
+{
+    // sub rdi, -128; sub rsi, -128
+    static const uint8_t bias[] = {0x48, 0x83, 0xEF, 0x80, 0x48, 0x83, 0xEE, 0x80};
+    for (uint32_t i = 0; i < sizeof(bias); i++)
+        Emit(e, bias[i]);
+
+    for (uint32_t n = 0; n < numCells; n++)
+    {
+        for (uint32_t i = 0; i < MUM_CELL_SIZE; i++)
+        {
+            EmitLoadMasked(e, 0, gather[0] + sourceBytes[0][i], bitmasks[0]);
+            for (uint32_t p = 1; p < MUM_NUM_POSITIONS; p++)
+            {
+                EmitLoadMasked(e, 1, gather[p] + sourceBytes[p][i], bitmasks[p]);
+                // or eax, ecx
+                Emit(e, 0x09);
+                Emit(e, 0xC8);
+            }
+            // mov byte [rsi + disp], al
+            Emit(e, 0x88);
+            EmitDisp(e, 0x06, n * MUM_CELL_SIZE + i);
+        }
+        gather += MUM_NUM_POSITIONS;
+    }
+    // ret
+    Emit(e, 0xC3);
+}
+
+// all 16 routines, at offsets recorded in jit when its code is set
+static void EmitAll(TMumJitEmitter *e, TMumInfo *mumInfo, TMumJitCode *jit)
+{
+    uint32_t numCells = mumInfo->numRows * MUM_CELLS_X;
+
+    for (uint32_t round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+        if (jit)
+            jit->encryptDiffuse[round] = (TMumJitDiffuse)(jit->code + e->size);
+        EmitDiffuse(e, numCells, schedule->gather[0], schedule->bitmasks, mumEncryptSourceBytes);
+        if (jit)
+            jit->decryptDiffuse[round] = (TMumJitDiffuse)(jit->code + e->size);
+        EmitDiffuse(e, numCells, schedule->gatherI[0], schedule->bitmasks, mumDecryptSourceBytes);
+    }
+}
+
+bool MumJitSupported()
+{
+    return true;
+}
+
+bool MumJitBuild(TMumInfo *mumInfo)
+{
+    TMumJitEmitter e = {nullptr, 0};
+
+    MumJitFree(mumInfo);
+    EmitAll(&e, mumInfo, nullptr);
+
+    TMumJitCode *jit = new TMumJitCode;
+    jit->size = e.size;
+    void *code = mmap(nullptr, jit->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+    {
+        delete jit;
+        return false;
+    }
+    jit->code = (uint8_t *)code;
+    e.buffer = jit->code;
+    e.size = 0;
+    EmitAll(&e, mumInfo, jit);
+    if (mprotect(jit->code, jit->size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(jit->code, jit->size);
+        delete jit;
+        return false;
+    }
+    mumInfo->jitCode = jit;
+    return true;
+}
+
+void MumJitFree(TMumInfo *mumInfo)
+{
+    MumJitFreeCode(mumInfo->jitCode);
+    mumInfo->jitCode = nullptr;
+}
+
+void MumJitFreeCode(TMumJitCode *jitCode)
+{
+    if (jitCode == nullptr)
+        return;
+    munmap(jitCode->code, jitCode->size);
+    delete jitCode;
+}
+
+#else
+
+bool MumJitSupported()
+{
+    return false;
+}
+
+bool MumJitBuild(TMumInfo *mumInfo)
+{
+    mumInfo->jitCode = nullptr;
+    return false;
+}
+
+void MumJitFree(TMumInfo *mumInfo)
+{
+    mumInfo->jitCode = nullptr;
+}
+
+void MumJitFreeCode(TMumJitCode *jitCode)
+{
+}
+
+#endif
@@ -0,0 +1,250 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumkeycache.h"
+#include "mumalloc.h"
+#include <string.h>
+
+// only picks the candidates, the full key is compared
+uint64_t MumKeyDigest(const uint8_t *key)
+{
+    uint64_t digest = 0xcbf29ce484222325ull;
+    for (uint32_t i = 0; i < MUM_KEY_SIZE; i++)
+        digest = (digest ^ key[i]) * 0x100000001b3ull;
+    return digest;
+}
+
+size_t MumPositionTablesSize(TMumInfo *mumInfo)
+{
+    return (size_t)MUM_NUM_ROUNDS * 2 * mumInfo->encryptedBlockSize * MUM_NUM_8BIT_VALUES;
+}
+
+void MumCopyPositionTables(TMumInfo *mumInfo, const uint8_t *positionPermuteTables)
+{
+    for (uint32_t round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        mumInfo->positionPermute[round] = nullptr;
+        mumInfo->positionPermuteI[round] = nullptr;
+    }
+    if (mumInfo->scheduleType != MUM_SCHEDULE_TYPE_POSITION_TABLES || positionPermuteTables == nullptr)
+        return;
+
+    size_t tableSize = (size_t)mumInfo->encryptedBlockSize * MUM_NUM_8BIT_VALUES;
+    if (mumInfo->positionPermuteTables == nullptr)
+        mumInfo->positionPermuteTables = (uint8_t *)MumAllocHugePages(MumPositionTablesSize(mumInfo));
+    memcpy(mumInfo->positionPermuteTables, positionPermuteTables, MumPositionTablesSize(mumInfo));
+    for (uint32_t round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        mumInfo->positionPermute[round] = mumInfo->positionPermuteTables + 2 * round * tableSize;
+        mumInfo->positionPermuteI[round] = mumInfo->positionPermute[round] + tableSize;
+    }
+}
+
+CMumKeyCache *CMumKeyCache::Instance()
+{
+    static CMumKeyCache keyCache;
+    return &keyCache;
+}
+
+CMumKeyCache::CMumKeyCache()
+{
+    pthread_mutex_init(&mMutex, NULL);
+    mBudget = 0;
+    mSize = 0;
+}
+
+CMumKeyCache::~CMumKeyCache()
+{
+    Clear();
+    pthread_mutex_destroy(&mMutex);
+}
+
+TMumKeyCacheEntry *CMumKeyCache::Acquire(const uint8_t *key, TMumInfo *mumInfo)
+{
+    uint64_t digest = MumKeyDigest(key);
+    TMumKeyCacheEntry *entry = nullptr;
+
+    pthread_mutex_lock(&mMutex);
+    auto it = Find(digest, key, mumInfo->blockType);
+    if (it != mEntries.end())
+    {
+        entry = *it;
+        entry->refCount++;
+        mEntries.splice(mEntries.begin(), mEntries, it);
+    }
+    pthread_mutex_unlock(&mMutex);
+    return entry;
+}
+
+size_t CMumKeyCache::EntrySize(TMumInfo *mumInfo)
+{
+    size_t size = sizeof(TMumKeyTables);
+    if (mumInfo->positionPermuteTables != nullptr)
+        size += MumPositionTablesSize(mumInfo);
+    return size;
+}
+
+bool CMumKeyCache::Accepts(TMumInfo *mumInfo)
+{
+    pthread_mutex_lock(&mMutex);
+    bool accepts = EntrySize(mumInfo) <= mBudget;
+    pthread_mutex_unlock(&mMutex);
+    return accepts;
+}
+
+TMumKeyCacheEntry *CMumKeyCache::Store(TMumInfo *mumInfo)
+{
+    uint64_t digest = MumKeyDigest(mumInfo->tables->key);
+    size_t size = EntrySize(mumInfo);
+
+    pthread_mutex_lock(&mMutex);
+    bool cached = size > mBudget || Find(digest, mumInfo->tables->key, mumInfo->blockType) != mEntries.end();
+    pthread_mutex_unlock(&mMutex);
+    if (cached)
+        return nullptr;
+
+    // position tables copied outside the lock; another engine may store
+    // the same key meanwhile, the second entry is then dropped below
+    TMumKeyCacheEntry *entry = new TMumKeyCacheEntry;
+    entry->digest = digest;
+    entry->blockType = mumInfo->blockType;
+    entry->size = size;
+    entry->refCount = 1;
+    entry->evicted = false;
+    entry->tables = mumInfo->tables;
+    entry->positionPermuteTables = nullptr;
+    if (mumInfo->positionPermuteTables != nullptr)
+    {
+        entry->positionPermuteTables = (uint8_t *)MumAllocHugePages(MumPositionTablesSize(mumInfo));
+        if (entry->positionPermuteTables == nullptr)
+        {
+            delete entry;
+            return nullptr;
+        }
+        memcpy(entry->positionPermuteTables, mumInfo->positionPermuteTables, MumPositionTablesSize(mumInfo));
+    }
+
+    pthread_mutex_lock(&mMutex);
+    cached = size > mBudget || Find(digest, mumInfo->tables->key, mumInfo->blockType) != mEntries.end();
+    if (!cached)
+    {
+        EvictToBudget(mBudget - size);
+        mEntries.push_front(entry);
+        mSize += size;
+    }
+    pthread_mutex_unlock(&mMutex);
+    if (cached)
+    {
+        MumFree(entry->positionPermuteTables);
+        delete entry;
+        return nullptr;
+    }
+    return entry;
+}
+
+void CMumKeyCache::Release(TMumKeyCacheEntry *entry)
+{
+    pthread_mutex_lock(&mMutex);
+    Unreference(entry);
+    pthread_mutex_unlock(&mMutex);
+}
+
+void CMumKeyCache::SetBudget(size_t budget)
+{
+    pthread_mutex_lock(&mMutex);
+    mBudget = budget;
+    EvictToBudget(budget);
+    pthread_mutex_unlock(&mMutex);
+}
+
+void CMumKeyCache::GetUsage(size_t *size, uint32_t *numEntries)
+{
+    pthread_mutex_lock(&mMutex);
+    *size = mSize;
+    *numEntries = (uint32_t)mEntries.size();
+    pthread_mutex_unlock(&mMutex);
+}
+
+void CMumKeyCache::Evict(uint8_t *key)
+{
+    uint64_t digest = MumKeyDigest(key);
+    pthread_mutex_lock(&mMutex);
+    auto it = mEntries.begin();
+    while (it != mEntries.end())
+    {
+        auto next = std::next(it);
+        if ((*it)->digest == digest && !memcmp((*it)->tables->key, key, MUM_KEY_SIZE))
+            EvictEntry(it);
+        it = next;
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+void CMumKeyCache::Clear()
+{
+    pthread_mutex_lock(&mMutex);
+    EvictToBudget(0);
+    pthread_mutex_unlock(&mMutex);
+}
+
+// with mMutex held
+std::list<TMumKeyCacheEntry *>::iterator CMumKeyCache::Find(uint64_t digest, const uint8_t *key, EMumBlockType blockType)
+{
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+    {
+        if ((*it)->digest == digest && (*it)->blockType == blockType && !memcmp((*it)->tables->key, key, MUM_KEY_SIZE))
+            return it;
+    }
+    return mEntries.end();
+}
+
+// with mMutex held
+void CMumKeyCache::EvictEntry(std::list<TMumKeyCacheEntry *>::iterator it)
+{
+    TMumKeyCacheEntry *entry = *it;
+    mEntries.erase(it);
+    mSize -= entry->size;
+    entry->evicted = true;
+    entry->refCount++;
+    Unreference(entry);
+}
+
+// with mMutex held; least recently used first
+void CMumKeyCache::EvictToBudget(size_t budget)
+{
+    while (mSize > budget)
+        EvictEntry(std::prev(mEntries.end()));
+}
+
+// with mMutex held
+void CMumKeyCache::Unreference(TMumKeyCacheEntry *entry)
+{
+    entry->refCount--;
+    if (entry->refCount == 0 && entry->evicted)
+    {
+        MumFree(entry->tables);
+        MumFree(entry->positionPermuteTables);
+        delete entry;
+    }
+}
@@ -0,0 +1,239 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumkeystore.h"
+#include "mumengine.h"
+#include "mumalloc.h"
+#include <string.h>
+
+CMumKeyStore::CMumKeyStore(EMumBlockType blockType, size_t budget)
+{
+    mBlockType = blockType;
+    pthread_mutex_init(&mMutex, NULL);
+    pthread_mutex_init(&mExpandMutex, NULL);
+    mBudget = budget;
+    mSize = 0;
+    mHits = 0;
+    mMisses = 0;
+    mEvictions = 0;
+    mEngine = new CMumEngine(MUM_ENGINE_TYPE_CPU, blockType, MUM_PADDING_TYPE_ON, 1);
+}
+
+CMumKeyStore::~CMumKeyStore()
+{
+    pthread_mutex_lock(&mMutex);
+    while (!mEntries.empty())
+        EvictEntry(mEntries.back());
+    for (TMumKeyStoreKey *key : mKeys)
+        delete key;
+    pthread_mutex_unlock(&mMutex);
+    delete mEngine;
+    pthread_mutex_destroy(&mExpandMutex);
+    pthread_mutex_destroy(&mMutex);
+}
+
+EMumError CMumKeyStore::Add(uint8_t *key, uint32_t *keyId)
+{
+    TMumKeyStoreKey *storeKey = new TMumKeyStoreKey;
+    memcpy(storeKey->key, key, MUM_KEY_SIZE);
+    storeKey->entry = nullptr;
+
+    pthread_mutex_lock(&mMutex);
+    if (mFreeIds.empty())
+    {
+        *keyId = (uint32_t)mKeys.size();
+        mKeys.push_back(storeKey);
+    }
+    else
+    {
+        *keyId = mFreeIds.back();
+        mFreeIds.pop_back();
+        mKeys[*keyId] = storeKey;
+    }
+    pthread_mutex_unlock(&mMutex);
+    return MUM_ERROR_OK;
+}
+
+EMumError CMumKeyStore::Remove(uint32_t keyId)
+{
+    pthread_mutex_lock(&mMutex);
+    if (keyId >= mKeys.size() || mKeys[keyId] == nullptr)
+    {
+        pthread_mutex_unlock(&mMutex);
+        return MUM_ERROR_KEYSTORE_KEY_NOT_FOUND;
+    }
+    if (mKeys[keyId]->entry != nullptr)
+        EvictEntry(mKeys[keyId]->entry);
+    delete mKeys[keyId];
+    mKeys[keyId] = nullptr;
+    mFreeIds.push_back(keyId);
+    pthread_mutex_unlock(&mMutex);
+    return MUM_ERROR_OK;
+}
+
+void CMumKeyStore::SetBudget(size_t budget)
+{
+    pthread_mutex_lock(&mMutex);
+    mBudget = budget;
+    EvictToBudget(budget);
+    pthread_mutex_unlock(&mMutex);
+}
+
+void CMumKeyStore::GetStats(TMumKeyStoreStats *stats)
+{
+    pthread_mutex_lock(&mMutex);
+    stats->hits = mHits;
+    stats->misses = mMisses;
+    stats->evictions = mEvictions;
+    stats->numKeys = (uint32_t)(mKeys.size() - mFreeIds.size());
+    stats->numExpanded = (uint32_t)mEntries.size();
+    stats->size = mSize;
+    stats->budget = mBudget;
+    pthread_mutex_unlock(&mMutex);
+}
+
+EMumError CMumKeyStore::Acquire(uint32_t keyId, TMumKeyStoreEntry **entry)
+{
+    uint8_t key[MUM_KEY_SIZE];
+
+    pthread_mutex_lock(&mMutex);
+    if (!HasKey(keyId, nullptr))
+    {
+        pthread_mutex_unlock(&mMutex);
+        return MUM_ERROR_KEYSTORE_KEY_NOT_FOUND;
+    }
+    bool hit = Hit(keyId, entry);
+    memcpy(key, mKeys[keyId]->key, MUM_KEY_SIZE);
+    pthread_mutex_unlock(&mMutex);
+    if (hit)
+        return MUM_ERROR_OK;
+
+    // expanded outside mMutex, so that hits go on meanwhile; expansions take
+    // turns, and one that waited for the same key finds it expanded
+    pthread_mutex_lock(&mExpandMutex);
+    pthread_mutex_lock(&mMutex);
+    bool removed = !HasKey(keyId, key);
+    hit = !removed && Hit(keyId, entry);
+    pthread_mutex_unlock(&mMutex);
+    if (removed || hit)
+    {
+        pthread_mutex_unlock(&mExpandMutex);
+        return removed ? MUM_ERROR_KEYSTORE_KEY_NOT_FOUND : MUM_ERROR_OK;
+    }
+
+    TMumKeyStoreEntry *expanded = new TMumKeyStoreEntry;
+    expanded->tables = (TMumKeyTables *)MumAlloc(sizeof(TMumKeyTables));
+    expanded->keyId = keyId;
+    expanded->refCount = 1;
+    expanded->evicted = false;
+    if (expanded->tables == nullptr || mEngine->ExpandKey(key, expanded->tables) != MUM_ERROR_OK)
+    {
+        pthread_mutex_unlock(&mExpandMutex);
+        MumFree(expanded->tables);
+        delete expanded;
+        return MUM_ERROR_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_lock(&mMutex);
+    pthread_mutex_unlock(&mExpandMutex);
+    if (!HasKey(keyId, key))
+    {
+        pthread_mutex_unlock(&mMutex);
+        MumFree(expanded->tables);
+        delete expanded;
+        return MUM_ERROR_KEYSTORE_KEY_NOT_FOUND;
+    }
+    mMisses++;
+    mKeys[keyId]->entry = expanded;
+    mEntries.push_front(expanded);
+    expanded->position = mEntries.begin();
+    mSize += sizeof(TMumKeyTables);
+    // with a budget below one expansion, this one is evicted too and freed
+    // by Release
+    EvictToBudget(mBudget);
+    pthread_mutex_unlock(&mMutex);
+    *entry = expanded;
+    return MUM_ERROR_OK;
+}
+
+// with mMutex held; key, if given, must match as the ids of removed keys
+// are reused
+bool CMumKeyStore::HasKey(uint32_t keyId, uint8_t *key)
+{
+    if (keyId >= mKeys.size() || mKeys[keyId] == nullptr)
+        return false;
+    return key == nullptr || memcmp(mKeys[keyId]->key, key, MUM_KEY_SIZE) == 0;
+}
+
+// with mMutex held; references the expansion of keyId, if there is one
+bool CMumKeyStore::Hit(uint32_t keyId, TMumKeyStoreEntry **entry)
+{
+    TMumKeyStoreEntry *found = mKeys[keyId]->entry;
+    if (found == nullptr)
+        return false;
+    mHits++;
+    found->refCount++;
+    mEntries.splice(mEntries.begin(), mEntries, found->position);
+    *entry = found;
+    return true;
+}
+
+void CMumKeyStore::Release(TMumKeyStoreEntry *entry)
+{
+    pthread_mutex_lock(&mMutex);
+    Unreference(entry);
+    pthread_mutex_unlock(&mMutex);
+}
+
+// with mMutex held
+void CMumKeyStore::EvictEntry(TMumKeyStoreEntry *entry)
+{
+    mEntries.erase(entry->position);
+    mSize -= sizeof(TMumKeyTables);
+    mKeys[entry->keyId]->entry = nullptr;
+    entry->evicted = true;
+    entry->refCount++;
+    Unreference(entry);
+}
+
+// with mMutex held; least recently used first
+void CMumKeyStore::EvictToBudget(size_t budget)
+{
+    while (mSize > budget)
+    {
+        EvictEntry(mEntries.back());
+        mEvictions++;
+    }
+}
+
+// with mMutex held
+void CMumKeyStore::Unreference(TMumKeyStoreEntry *entry)
+{
+    entry->refCount--;
+    if (entry->refCount == 0 && entry->evicted)
+    {
+        MumFree(entry->tables);
+        delete entry;
+    }
+}
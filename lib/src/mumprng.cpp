@@ -31,12 +31,16 @@
 
 
 
-CMumPrng::CMumPrng(uint8_t *subkeyData)
+CMumPrng::CMumPrng(uint8_t *subkeyData) : CMumPrng(subkeyData, 0)
+{
+}
+
+CMumPrng::CMumPrng(uint8_t *subkeyData, uint32_t stream)
 {
     memcpy(mSubkeyData, subkeyData, MUM_PRNG_SUBKEY_SIZE);
     memset(mReadyData, 0, MUM_PRNG_SUBKEY_SIZE);
     mReadIndex = 0;
-    Init();
+    Init(stream);
     Regenerate();
 }
 
@@ -52,7 +56,7 @@ static __inline void swap(uint8_t *a, uint8_t *b)
     *b = temp;
 }
 
-void CMumPrng::Init()
+void CMumPrng::Init(uint32_t stream)
 {
     mA = 0;
     mB = 0;
@@ -62,12 +66,14 @@ void CMumPrng::Init()
         mState[i] = i;
 
     // our subkey area is 64KB -- for the state initialization we will
-    // use a 256-byte from there, 89 bytes before the end.
+    // use a 256-byte from there, 89 bytes before the end. The stream id
+    // is XORed into it, its four bytes repeated.
     uint8_t *prngKey = &mSubkeyData[MUM_PRNG_SUBKEY_SIZE - 256 - 89];
     uint32_t j = 0;
     for (int i = 0; i < 256; i++)
     {
-        j = (j + mState[i] + prngKey[i]) & 255;
+        uint8_t streamByte = (uint8_t)(stream >> (8 * (i & 3)));
+        j = (j + mState[i] + (prngKey[i] ^ streamByte)) & 255;
         swap(&mState[i], &mState[j]);
     }
 }
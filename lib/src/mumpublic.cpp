@@ -24,6 +24,11 @@
 
 #include "mumpublic.h"
 #include "mumengine.h"
+#include "mumcontext.h"
+#include "mumkeycache.h"
+#include "mumschedulefile.h"
+#include "mumkeystore.h"
+#include "mumalloc.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -59,18 +64,171 @@ EMumError MumEncryptedBlockSize(void *mev, uint32_t *encryptedBlockSize)
     return MUM_ERROR_OK;
 }
 
+EMumError MumSetKernelType(void *mev, EMumKernelType kernelType)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->SetKernelType(kernelType);
+}
+
+EMumError MumGetKernelType(void *mev, EMumKernelType *kernelType)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    *kernelType = me->GetKernelType();
+    return MUM_ERROR_OK;
+}
+
+EMumError MumSetKernelMode(void *mev, EMumKernelMode kernelMode)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->SetKernelMode(kernelMode);
+}
+
+EMumError MumGetKernelMode(void *mev, EMumKernelMode *kernelMode)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    *kernelMode = me->GetKernelMode();
+    return MUM_ERROR_OK;
+}
+
+EMumError MumSetScheduleType(void *mev, EMumScheduleType scheduleType)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->SetScheduleType(scheduleType);
+}
+
+EMumError MumGetScheduleType(void *mev, EMumScheduleType *scheduleType)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    *scheduleType = me->GetScheduleType();
+    return MUM_ERROR_OK;
+}
+
+void *MumCreateContext(void *mev)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->CreateContext();
+}
+
+void MumDestroyContext(void *mcv)
+{
+    CMumContext *mc = (CMumContext *)mcv;
+    delete mc;
+}
+
+EMumError MumContextEncrypt(void *mcv, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum)
+{
+    CMumContext *mc = (CMumContext *)mcv;
+    return mc->Encrypt(src, dst, length, outlength, seqNum);
+}
+
+EMumError MumContextDecrypt(void *mcv, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength)
+{
+    CMumContext *mc = (CMumContext *)mcv;
+    return mc->Decrypt(src, dst, length, outlength);
+}
+
 EMumError MumInitKey(void *mev, uint8_t *key)
 {
     CMumEngine *me = (CMumEngine *)mev;
     return me->InitKey(key);
 }
 
+EMumError MumSetKeyCacheBudget(size_t budget)
+{
+    CMumKeyCache::Instance()->SetBudget(budget);
+    return MUM_ERROR_OK;
+}
+
+EMumError MumGetKeyCacheUsage(size_t *size, uint32_t *numEntries)
+{
+    CMumKeyCache::Instance()->GetUsage(size, numEntries);
+    return MUM_ERROR_OK;
+}
+
+EMumError MumEvictKey(uint8_t *key)
+{
+    CMumKeyCache::Instance()->Evict(key);
+    return MUM_ERROR_OK;
+}
+
+EMumError MumSetHugePages(uint32_t enable)
+{
+    MumAllocSetHugePages(enable != 0);
+    return MUM_ERROR_OK;
+}
+
+void *MumCreateKeyStore(EMumBlockType blockType, size_t budget)
+{
+    return new CMumKeyStore(blockType, budget);
+}
+
+void MumDestroyKeyStore(void *ksv)
+{
+    CMumKeyStore *ks = (CMumKeyStore *)ksv;
+    delete ks;
+}
+
+EMumError MumKeyStoreAdd(void *ksv, uint8_t *key, uint32_t *keyId)
+{
+    CMumKeyStore *ks = (CMumKeyStore *)ksv;
+    return ks->Add(key, keyId);
+}
+
+EMumError MumKeyStoreRemove(void *ksv, uint32_t keyId)
+{
+    CMumKeyStore *ks = (CMumKeyStore *)ksv;
+    return ks->Remove(keyId);
+}
+
+EMumError MumSetKeyStoreBudget(void *ksv, size_t budget)
+{
+    CMumKeyStore *ks = (CMumKeyStore *)ksv;
+    ks->SetBudget(budget);
+    return MUM_ERROR_OK;
+}
+
+EMumError MumGetKeyStoreStats(void *ksv, TMumKeyStoreStats *stats)
+{
+    CMumKeyStore *ks = (CMumKeyStore *)ksv;
+    ks->GetStats(stats);
+    return MUM_ERROR_OK;
+}
+
+EMumError MumInitStoreKey(void *mev, void *ksv, uint32_t keyId)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->InitStoreKey((CMumKeyStore *)ksv, keyId);
+}
+
 EMumError MumLoadKey(void *mev, const char *keyfile)
 {
     CMumEngine *me = (CMumEngine *)mev;
     return me->LoadKey(keyfile);
 }
 
+EMumError MumSaveKeySchedule(void *mev, const char *schedulefile)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->SaveKeySchedule(schedulefile);
+}
+
+EMumError MumLoadKeySchedule(void *mev, const char *schedulefile)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->LoadKeySchedule(schedulefile);
+}
+
+EMumError MumInitSharedKey(void *mev, uint8_t *key, const char *name)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->InitSharedKey(key, name);
+}
+
+EMumError MumUnlinkSharedKey(EMumBlockType blockType, const char *name)
+{
+    return MumUnlinkSharedSchedule(blockType, name);
+}
+
 EMumError MumEncryptFile(void *mev, const char *srcfile, const char *dstfile)
 {
     CMumEngine *me = (CMumEngine *)mev;
@@ -95,6 +253,18 @@ EMumError MumDecrypt(void *mev, uint8_t *src, uint8_t *dst, uint32_t length, uin
     return me->Decrypt(src, dst, length, outlength);
 }
 
+EMumError MumEncryptWithBlockType(void *mev, EMumBlockType blockType, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength, uint16_t seqNum)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->EncryptWithBlockType(blockType, src, dst, length, outlength, seqNum);
+}
+
+EMumError MumDecryptWithBlockType(void *mev, EMumBlockType *blockType, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t *outlength)
+{
+    CMumEngine *me = (CMumEngine *)mev;
+    return me->DecryptWithBlockType(blockType, src, dst, length, outlength);
+}
+
 EMumError MumEncryptBlock(void *mev, uint8_t *src, uint8_t *dst, uint32_t length, uint32_t seqnum)
 {
     CMumEngine *me = (CMumEngine *)mev;
@@ -115,17 +285,20 @@ EMumError MumGetSubkey(void *mev, uint32_t index, uint8_t *subkey)
 
 void *MumCreateEngine(EMumEngineType engineType, EMumBlockType blockType, EMumPaddingType paddingType, uint32_t numThreads)
 {
+    switch (engineType)
+    {
+    case MUM_ENGINE_TYPE_CPU:
+    case MUM_ENGINE_TYPE_CPU_MT:
+    case MUM_ENGINE_TYPE_CPU_BITSLICE:
 #ifdef USE_OPENGL
-    if (engineType > MUM_ENGINE_TYPE_GPU_B) {
-        printf("what? engineType is %d", engineType);
-        return NULL;
-    }
-#else
-    if (engineType > MUM_ENGINE_TYPE_CPU_MT) {
-        printf("what what? engineType is %d\n", engineType);
+    case MUM_ENGINE_TYPE_GPU_A:
+    case MUM_ENGINE_TYPE_GPU_B:
+#endif
+        break;
+    default:
+        printf("what? engineType is %d\n", engineType);
         return NULL;
     }
-#endif
     CMumEngine *me = new CMumEngine(engineType, blockType, paddingType, numThreads);
     return me;
 }
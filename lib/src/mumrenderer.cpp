@@ -27,75 +27,163 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "mumrenderer.h"
+#include "mumalloc.h"
+#ifdef USE_SIMD
+#include <emmintrin.h>
+#endif
+
+// Compile-time geometry of a padded block, read off its TMumBlockR* layout:
+// the two data pieces, which hold the plaintext back to back, the four
+// padding pieces, filled from the PRNG padding in order, and the
+// checksum/length/seqnum header between them.
+template <typename TBlock, EMumBlockType BLOCK_TYPE>
+struct TMumBlockGeometry
+{
+    typedef TBlock TLayout;
+    static const uint32_t blockType = BLOCK_TYPE;
+    static const uint32_t sizeA = sizeof(TBlock::dataA);
+    static const uint32_t sizeB = sizeof(TBlock::dataB);
+    static const uint32_t encryptSize = sizeA + sizeB;
+    static const uint32_t paddingSize = sizeof(TBlock::paddingA) + sizeof(TBlock::paddingB) +
+                                        sizeof(TBlock::paddingC) + sizeof(TBlock::paddingD);
+    static_assert(sizeof(TBlock) == encryptSize + paddingSize + 8, "block layout has unaccounted bytes");
+    static_assert(encryptSize % 4 == 0, "the checksum sums whole words");
+};
+
+typedef TMumBlockGeometry<TMumBlockR32, MUM_BLOCKTYPE_4096> TMumGeometryR32;
+typedef TMumBlockGeometry<TMumBlockR16, MUM_BLOCKTYPE_2048> TMumGeometryR16;
+typedef TMumBlockGeometry<TMumBlockR8, MUM_BLOCKTYPE_1024> TMumGeometryR8;
+typedef TMumBlockGeometry<TMumBlockR4, MUM_BLOCKTYPE_512> TMumGeometryR4;
+typedef TMumBlockGeometry<TMumBlockR2, MUM_BLOCKTYPE_256> TMumGeometryR2;
+typedef TMumBlockGeometry<TMumBlockR1, MUM_BLOCKTYPE_128> TMumGeometryR1;
+
+static_assert(TMumGeometryR32::encryptSize == MUM_ENCRYPT_SIZE_R32 && TMumGeometryR32::paddingSize == MUM_PADDING_SIZE_R32, "R32");
+static_assert(TMumGeometryR16::encryptSize == MUM_ENCRYPT_SIZE_R16 && TMumGeometryR16::paddingSize == MUM_PADDING_SIZE_R16, "R16");
+static_assert(TMumGeometryR8::encryptSize == MUM_ENCRYPT_SIZE_R8 && TMumGeometryR8::paddingSize == MUM_PADDING_SIZE_R8, "R8");
+static_assert(TMumGeometryR4::encryptSize == MUM_ENCRYPT_SIZE_R4 && TMumGeometryR4::paddingSize == MUM_PADDING_SIZE_R4, "R4");
+static_assert(TMumGeometryR2::encryptSize == MUM_ENCRYPT_SIZE_R2 && TMumGeometryR2::paddingSize == MUM_PADDING_SIZE_R2, "R2");
+static_assert(TMumGeometryR1::encryptSize == MUM_ENCRYPT_SIZE_R1 && TMumGeometryR1::paddingSize == MUM_PADDING_SIZE_R1, "R1");
+
+void CMumRenderer::InitBlockGeometry(TMumInfo *mumInfo)
+{
+    switch (mumInfo->blockType)
+    {
+    case MUM_BLOCKTYPE_4096:
+        mumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R32;
+        mumInfo->plaintextBlockSize = mumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R32 : MUM_BLOCK_SIZE_R32;
+        mumInfo->paddingSize = MUM_PADDING_SIZE_R32;
+        mumInfo->numRows = 32;
+        break;
+
+    case MUM_BLOCKTYPE_2048:
+        mumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R16;
+        mumInfo->plaintextBlockSize = mumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R16 : MUM_BLOCK_SIZE_R16;
+        mumInfo->paddingSize = MUM_PADDING_SIZE_R16;
+        mumInfo->numRows = 16;
+        break;
+
+    case MUM_BLOCKTYPE_1024:
+        mumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R8;
+        mumInfo->plaintextBlockSize = mumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R8 : MUM_BLOCK_SIZE_R8;
+        mumInfo->paddingSize = MUM_PADDING_SIZE_R8;
+        mumInfo->numRows = 8;
+        break;
+
+    case MUM_BLOCKTYPE_512:
+        mumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R4;
+        mumInfo->plaintextBlockSize = mumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R4 : MUM_BLOCK_SIZE_R4;
+        mumInfo->paddingSize = MUM_PADDING_SIZE_R4;
+        mumInfo->numRows = 4;
+        break;
+
+    case MUM_BLOCKTYPE_256:
+        mumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R2;
+        mumInfo->plaintextBlockSize = mumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R2 : MUM_BLOCK_SIZE_R2;
+        mumInfo->paddingSize = MUM_PADDING_SIZE_R2;
+        mumInfo->numRows = 2;
+        break;
+
+    case MUM_BLOCKTYPE_128:
+        mumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R1;
+        mumInfo->plaintextBlockSize = mumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R1 : MUM_BLOCK_SIZE_R1;
+        mumInfo->paddingSize = MUM_PADDING_SIZE_R1;
+        mumInfo->numRows = 1;
+        break;
+
+    default:
+        mumInfo->encryptedBlockSize = 0;
+        mumInfo->plaintextBlockSize = 0;
+        mumInfo->paddingSize = 0;
+        mumInfo->numRows = 0;
+        break;
+    }
+}
+
+void CMumRenderer::CreateTextureData()
+{
+    mMumInfo->textureData = new TMumTextureData;
+    for (uint32_t row = 0; row < MUM_NUM_8BIT_VALUES; row++)
+    {
+        for (uint32_t col = 0; col < MUM_NUM_8BIT_VALUES; col++)
+        {
+            mMumInfo->textureData->xorTextureData[row * MUM_NUM_8BIT_VALUES + col] = (uint8_t)(row ^ col);
+        }
+    }
+}
+
+void CMumRenderer::DeleteTextureData()
+{
+    delete mMumInfo->textureData;
+    mMumInfo->textureData = nullptr;
+}
 
 CMumRenderer::CMumRenderer(TMumInfo *mumInfo)
 {
     mMumInfo = mumInfo;
     mPrng = nullptr;
+    mBatchBlocks = nullptr;
+    mBatchBlocksCapacity = 0;
     switch (mMumInfo->blockType)
     {
     case MUM_BLOCKTYPE_4096:
-        mMumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R32;
-        mMumInfo->plaintextBlockSize = mMumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R32 : MUM_BLOCK_SIZE_R32;
-        mMumInfo->paddingSize = MUM_PADDING_SIZE_R32;
-        mMumInfo->numRows = 32;
-        packData = &CMumRenderer::PackDataR32;
-        unpackData = &CMumRenderer::UnpackDataR32;
+        packData = &CMumRenderer::PackData<TMumGeometryR32>;
+        unpackData = &CMumRenderer::UnpackData<TMumGeometryR32>;
         break;
 
     case MUM_BLOCKTYPE_2048:
-        mMumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R16;
-        mMumInfo->plaintextBlockSize = mMumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R16 : MUM_BLOCK_SIZE_R16;
-        mMumInfo->paddingSize = MUM_PADDING_SIZE_R16;
-        mMumInfo->numRows = 16;
-        packData = &CMumRenderer::PackDataR16;
-        unpackData = &CMumRenderer::UnpackDataR16;
+        packData = &CMumRenderer::PackData<TMumGeometryR16>;
+        unpackData = &CMumRenderer::UnpackData<TMumGeometryR16>;
         break;
 
     case MUM_BLOCKTYPE_1024:
-        mMumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R8;
-        mMumInfo->plaintextBlockSize = mMumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R8 : MUM_BLOCK_SIZE_R8;
-        mMumInfo->paddingSize = MUM_PADDING_SIZE_R8;
-        mMumInfo->numRows = 8;
-        packData = &CMumRenderer::PackDataR8;
-        unpackData = &CMumRenderer::UnpackDataR8;
+        packData = &CMumRenderer::PackData<TMumGeometryR8>;
+        unpackData = &CMumRenderer::UnpackData<TMumGeometryR8>;
         break;
 
     case MUM_BLOCKTYPE_512:
-        mMumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R4;
-        mMumInfo->plaintextBlockSize = mMumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R4 : MUM_BLOCK_SIZE_R4;
-        mMumInfo->paddingSize = MUM_PADDING_SIZE_R4;
-        mMumInfo->numRows = 4;
-        packData = &CMumRenderer::PackDataR4;
-        unpackData = &CMumRenderer::UnpackDataR4;
+        packData = &CMumRenderer::PackData<TMumGeometryR4>;
+        unpackData = &CMumRenderer::UnpackData<TMumGeometryR4>;
         break;
 
     case MUM_BLOCKTYPE_256:
-        mMumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R2;
-        mMumInfo->plaintextBlockSize = mMumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R2 : MUM_BLOCK_SIZE_R2;
-        mMumInfo->paddingSize = MUM_PADDING_SIZE_R2;
-        mMumInfo->numRows = 2;
-        packData = &CMumRenderer::PackDataR2;
-        unpackData = &CMumRenderer::UnpackDataR2;
+        packData = &CMumRenderer::PackData<TMumGeometryR2>;
+        unpackData = &CMumRenderer::UnpackData<TMumGeometryR2>;
         break;
 
     case MUM_BLOCKTYPE_128:
-        mMumInfo->encryptedBlockSize = MUM_BLOCK_SIZE_R1;
-        mMumInfo->plaintextBlockSize = mMumInfo->paddingOn ? MUM_ENCRYPT_SIZE_R1 : MUM_BLOCK_SIZE_R1;
-        mMumInfo->paddingSize = MUM_PADDING_SIZE_R1;
-        mMumInfo->numRows = 1;
-        packData = &CMumRenderer::PackDataR1;
-        unpackData = &CMumRenderer::UnpackDataR1;
+        packData = &CMumRenderer::PackData<TMumGeometryR1>;
+        unpackData = &CMumRenderer::UnpackData<TMumGeometryR1>;
         break;
     }
 
     numEncryptedBlocks = 0;
     numDecryptedBlocks = 0;
-    blockLatency = (mMumInfo->engineType < MUM_ENGINE_TYPE_GPU_B) ? 0 : 7;
+    blockLatency = (mMumInfo->engineType == MUM_ENGINE_TYPE_GPU_B) ? 7 : 0;
 }
 
 CMumRenderer::~CMumRenderer()
 {
+    MumFree(mBatchBlocks);
     if (mPrng != nullptr)
     {
         delete mPrng;
@@ -109,10 +197,23 @@ EMumError CMumRenderer::Encrypt(uint8_t *src, uint8_t *dst, uint32_t length, uin
     EMumError error = MUM_ERROR_OK;
     uint32_t latency = 0;
     uint8_t dummy[MUM_MAX_BLOCK_SIZE];
+    uint32_t batchSize = BatchSize();
 
     *outlength = 0;
     while (length > 0)
     {
+        if (batchSize > 1 && length >= batchSize * mMumInfo->plaintextBlockSize)
+        {
+            error = EncryptBatch(src, dst, seqNum);
+            if (error != MUM_ERROR_OK)
+                return error;
+            seqNum += (uint16_t)batchSize;
+            length -= batchSize * mMumInfo->plaintextBlockSize;
+            src += batchSize * mMumInfo->plaintextBlockSize;
+            dst += batchSize * mMumInfo->encryptedBlockSize;
+            *outlength += batchSize * mMumInfo->encryptedBlockSize;
+            continue;
+        }
         if (length >= mMumInfo->plaintextBlockSize)
             encryptSize = mMumInfo->plaintextBlockSize;
         else
@@ -156,6 +257,7 @@ EMumError CMumRenderer::Decrypt(uint8_t *src, uint8_t *dst, uint32_t length, uin
     EMumError error = MUM_ERROR_OK;
     uint32_t latency = 0;
     uint8_t *firstBlock = src;
+    uint32_t batchSize = BatchSize();
 
     if ((length % mMumInfo->encryptedBlockSize) != 0)
         return MUM_ERROR_INVALID_DECRYPT_SIZE;
@@ -164,6 +266,17 @@ EMumError CMumRenderer::Decrypt(uint8_t *src, uint8_t *dst, uint32_t length, uin
     while (length)
     {
         uint32_t encryptSize = 0;
+        if (batchSize > 1 && length >= batchSize * mMumInfo->encryptedBlockSize)
+        {
+            error = DecryptBatch(src, dst, &encryptSize);
+            if (error != MUM_ERROR_OK)
+                return error;
+            dst += encryptSize;
+            *outlength += encryptSize;
+            src += batchSize * mMumInfo->encryptedBlockSize;
+            length -= batchSize * mMumInfo->encryptedBlockSize;
+            continue;
+        }
         EMumError error = DecryptBlock(src, dst, &encryptSize, &seqnum);
         if (error == MUM_ERROR_BUFFER_WAIT_DECRYPT)
             latency++;
@@ -197,23 +310,13 @@ EMumError CMumRenderer::EncryptBlock(uint8_t *src, uint8_t *dst, uint32_t length
     if (mMumInfo->paddingOn)
     {
         SetPadding(src, length);
-        EMumError error = (this->*packData)(src, length, seqnum);
+        EMumError error = (this->*packData)(mPackedData, src, length, seqnum);
         if (error != MUM_ERROR_OK)
             return error;
-        EncryptUpload(mPackedData);
-    }
-    else
-    {
-        EncryptUpload(src);
-    }
-
-    for (uint32_t r = 0; r < mMumInfo->numRoundsPerBlock; r++)
-    {
-        EncryptDiffuse(r);
-        EncryptConfuse(r);
+        src = mPackedData;
     }
 
-    EncryptDownload(dst);
+    EncryptRounds(src, dst);
 
     numEncryptedBlocks++;
     if (numEncryptedBlocks <= blockLatency)
@@ -223,433 +326,226 @@ EMumError CMumRenderer::EncryptBlock(uint8_t *src, uint8_t *dst, uint32_t length
 
 EMumError CMumRenderer::DecryptBlock(uint8_t *src, uint8_t *dst, uint32_t *length, uint32_t *seqnum)
 {
-    DecryptUpload(src);
-    for (int r = mMumInfo->numRoundsPerBlock - 1; r >= 0; r--)
-    {
-        DecryptConfuse((uint32_t)r);
-        DecryptDiffuse((uint32_t)r);
-    }
+    DecryptRounds(src, mMumInfo->paddingOn ? mPackedData : dst);
     numDecryptedBlocks++;
     if (numDecryptedBlocks <= blockLatency)
         return MUM_ERROR_BUFFER_WAIT_DECRYPT;
     if (mMumInfo->paddingOn)
     {
-        DecryptDownload(mPackedData);
-        EMumError error = (this->*unpackData)(dst, length, seqnum);
+        EMumError error = (this->*unpackData)(mPackedData, dst, length, seqnum);
         if (error != MUM_ERROR_OK)
             return error;
     }
     else
     {
         *length = mMumInfo->plaintextBlockSize;
-        DecryptDownload(dst);
     }
     return MUM_ERROR_OK;
 }
 
-EMumError CMumRenderer::PackDataR32(uint8_t *unpackedData, uint32_t length, uint32_t seqnum)
+// staging for the packed blocks of one batch, grown to the renderer's batch
+// size; null if that fails
+uint8_t *CMumRenderer::BatchBlocks(uint32_t batchSize)
 {
-    TMumBlockR32 *block = (TMumBlockR32 *)mPackedData;
-
-    if (length > MUM_ENCRYPT_SIZE_R32)
-        return MUM_ERROR_INVALID_ENCRYPT_SIZE;
-
-    uint32_t checksum = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R32);
-
-    // first third of padding
-    memcpy(block->paddingA, &mPadding[0], 32);
-
-    // part A of data
-    memcpy(block->dataA, unpackedData, MUM_BLOCK_SIZE_A_R32);
-    unpackedData += MUM_BLOCK_SIZE_A_R32;
-
-    // second part of paddingxx
-    memcpy(block->paddingB, &mPadding[32], 12);
-
-    block->checksum[0] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[1] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[2] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[3] = (uint8_t)checksum;
-    length += (MUM_BLOCKTYPE_4096 << MUM_LENGTH_BLOCKTYPE_SHIFT);
-    block->length[0] = (uint8_t)(length % 256);
-    block->length[1] = (uint8_t)(length / 256);
-    block->seqnum[0] = (uint8_t)(seqnum % 256);
-    block->seqnum[1] = (uint8_t)(seqnum / 256);
-
-    // third part of padding
-    memcpy(block->paddingC, &mPadding[44], 12);
-
-    // second part of data
-    memcpy(block->dataB, unpackedData, MUM_BLOCK_SIZE_B_R32);
-
-    // fourth part of padding
-    memcpy(block->paddingD, &mPadding[56], 32);
-    return MUM_ERROR_OK;
+    if (batchSize > mBatchBlocksCapacity)
+    {
+        MumFree(mBatchBlocks);
+        mBatchBlocks = (uint8_t *)MumAlloc(batchSize * MUM_MAX_BLOCK_SIZE);
+        mBatchBlocksCapacity = mBatchBlocks != nullptr ? batchSize : 0;
+    }
+    return mBatchBlocks;
 }
 
-EMumError CMumRenderer::UnpackDataR32(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum)
+EMumError CMumRenderer::EncryptBatch(uint8_t *src, uint8_t *dst, uint16_t seqNum)
 {
-    TMumBlockR32 *block = (TMumBlockR32 *)mPackedData;
-
-    memcpy(unpackedData, block->dataA, MUM_BLOCK_SIZE_A_R32);
-    memcpy(unpackedData + MUM_BLOCK_SIZE_A_R32, block->dataB, MUM_BLOCK_SIZE_B_R32);
+    uint32_t batchSize = BatchSize();
 
-    uint32_t lengthField = block->length[0];
-    lengthField += block->length[1] << 8;
-    if (((lengthField & MUM_LENGTH_BLOCKTYPE_MASK) >> MUM_LENGTH_BLOCKTYPE_SHIFT) != MUM_BLOCKTYPE_4096)
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_BLOCKTYPE;
-    *length = (lengthField & MUM_LENGTH_LENGTH_MASK);
-    if (*length > MUM_ENCRYPT_SIZE_R32)
+    if (mMumInfo->paddingOn)
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_LENGTH;
+        uint8_t *blocks = BatchBlocks(batchSize);
+        if (blocks == nullptr)
+            return MUM_ERROR_OUT_OF_MEMORY;
+        // padding is fetched from the PRNG block by block, as in EncryptBlock;
+        // each block is packed straight into its batch slot
+        for (uint32_t i = 0; i < batchSize; i++)
+        {
+            uint8_t *block = src + i * mMumInfo->plaintextBlockSize;
+            SetPadding(block, mMumInfo->plaintextBlockSize);
+            EMumError error = (this->*packData)(blocks + i * MUM_MAX_BLOCK_SIZE, block, mMumInfo->plaintextBlockSize, (uint16_t)(seqNum + i));
+            if (error != MUM_ERROR_OK)
+                return error;
+        }
+        EncryptRoundsBatch(blocks, MUM_MAX_BLOCK_SIZE, dst, mMumInfo->encryptedBlockSize);
     }
-
-    uint32_t checksumA = block->checksum[0];
-    checksumA += block->checksum[1] << 8;
-    checksumA += block->checksum[2] << 16;
-    checksumA += block->checksum[3] << 24;
-    uint32_t checksumB = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R32);
-    if (checksumA != checksumB)
+    else
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_CHECKSUM;
+        EncryptRoundsBatch(src, mMumInfo->plaintextBlockSize, dst, mMumInfo->encryptedBlockSize);
     }
-
-    *seqnum = block->seqnum[0];
-    *seqnum += block->seqnum[1] << 8;
+    numEncryptedBlocks += batchSize;
     return MUM_ERROR_OK;
 }
 
-EMumError CMumRenderer::PackDataR16(uint8_t *unpackedData, uint32_t length, uint32_t seqnum)
+EMumError CMumRenderer::DecryptBatch(uint8_t *src, uint8_t *dst, uint32_t *length)
 {
-    TMumBlockR16 *block = (TMumBlockR16 *)mPackedData;
-
-    if (length > MUM_ENCRYPT_SIZE_R16)
-        return MUM_ERROR_INVALID_ENCRYPT_SIZE;
-
-    uint32_t checksum = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R16);
-
-    // first third of padding
-    memcpy(block->paddingA, &mPadding[0], 16);
+    uint32_t batchSize = BatchSize();
 
-    // part A of data
-    memcpy(block->dataA, unpackedData, MUM_BLOCK_SIZE_A_R16);
-    unpackedData += MUM_BLOCK_SIZE_A_R16;
-
-    // second part of padding
-    memcpy(block->paddingB, &mPadding[16], 4);
-
-    block->checksum[0] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[1] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[2] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[3] = (uint8_t)checksum;
-    length += (MUM_BLOCKTYPE_2048 << MUM_LENGTH_BLOCKTYPE_SHIFT);
-    block->length[0] = (uint8_t)(length % 256);
-    block->length[1] = (uint8_t)(length / 256);
-    block->seqnum[0] = (uint8_t)(seqnum % 256);
-    block->seqnum[1] = (uint8_t)(seqnum / 256);
-
-    // third part of padding
-    memcpy(block->paddingC, &mPadding[20], 4);
-
-    // second part of data
-    memcpy(block->dataB, unpackedData, MUM_BLOCK_SIZE_B_R16);
-
-    // fourth part of padding
-    memcpy(block->paddingD, &mPadding[24], 16);
-    return MUM_ERROR_OK;
-}
-
-EMumError CMumRenderer::UnpackDataR16(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum)
-{
-    TMumBlockR16 *block = (TMumBlockR16 *)mPackedData;
-
-    memcpy(unpackedData, block->dataA, MUM_BLOCK_SIZE_A_R16);
-    memcpy(unpackedData + MUM_BLOCK_SIZE_A_R16, block->dataB, MUM_BLOCK_SIZE_B_R16);
-
-    uint32_t lengthField = block->length[0];
-    lengthField += block->length[1] << 8;
-    if (((lengthField & MUM_LENGTH_BLOCKTYPE_MASK) >> MUM_LENGTH_BLOCKTYPE_SHIFT) != MUM_BLOCKTYPE_2048)
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_BLOCKTYPE;
-    *length = (lengthField & MUM_LENGTH_LENGTH_MASK);
-    if (*length > MUM_ENCRYPT_SIZE_R16)
+    *length = 0;
+    if (mMumInfo->paddingOn)
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_LENGTH;
+        uint8_t *blocks = BatchBlocks(batchSize);
+        if (blocks == nullptr)
+            return MUM_ERROR_OUT_OF_MEMORY;
+        DecryptRoundsBatch(src, mMumInfo->encryptedBlockSize, blocks, MUM_MAX_BLOCK_SIZE);
+        for (uint32_t i = 0; i < batchSize; i++)
+        {
+            uint32_t blockLength, seqnum;
+            EMumError error = (this->*unpackData)(blocks + i * MUM_MAX_BLOCK_SIZE, dst, &blockLength, &seqnum);
+            if (error != MUM_ERROR_OK)
+                return error;
+            dst += blockLength;
+            *length += blockLength;
+        }
     }
-
-    uint32_t checksumA = block->checksum[0];
-    checksumA += block->checksum[1] << 8;
-    checksumA += block->checksum[2] << 16;
-    checksumA += block->checksum[3] << 24;
-    uint32_t checksumB = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R16);
-    if (checksumA != checksumB)
+    else
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_CHECKSUM;
+        DecryptRoundsBatch(src, mMumInfo->encryptedBlockSize, dst, mMumInfo->plaintextBlockSize);
+        *length = batchSize * mMumInfo->plaintextBlockSize;
     }
-
-    *seqnum = block->seqnum[0];
-    *seqnum += block->seqnum[1] << 8;
+    numDecryptedBlocks += batchSize;
     return MUM_ERROR_OK;
 }
 
-EMumError CMumRenderer::PackDataR8(uint8_t *unpackedData, uint32_t length, uint32_t seqnum)
+void CMumRenderer::EncryptRounds(uint8_t *src, uint8_t *dst)
 {
-    TMumBlockR8 *block = (TMumBlockR8 *)mPackedData;
-
-    if (length > MUM_ENCRYPT_SIZE_R8)
-        return MUM_ERROR_INVALID_ENCRYPT_SIZE;
-
-    uint32_t checksum = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R8);
-
-    // first third of padding
-    memcpy(block->paddingA, &mPadding[0], 4);
-
-    // part A of data
-    memcpy(block->dataA, unpackedData, MUM_BLOCK_SIZE_A_R8);
-    unpackedData += MUM_BLOCK_SIZE_A_R8;
-
-    // second part of padding
-    memcpy(block->paddingB, &mPadding[4], 4);
-
-    block->checksum[0] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[1] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[2] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[3] = (uint8_t)checksum;
-    length += (MUM_BLOCKTYPE_1024 << MUM_LENGTH_BLOCKTYPE_SHIFT);
-    block->length[0] = (uint8_t)(length % 256);
-    block->length[1] = (uint8_t)(length / 256);
-    block->seqnum[0] = (uint8_t)(seqnum % 256);
-    block->seqnum[1] = (uint8_t)(seqnum / 256);
-
-    // third part of padding
-    memcpy(block->paddingC, &mPadding[8], 4);
-
-    // second part of data
-    memcpy(block->dataB, unpackedData, MUM_BLOCK_SIZE_B_R8);
-
-    // fourth part of padding
-    memcpy(block->paddingD, &mPadding[12], 4);
-    return MUM_ERROR_OK;
-}
-
-EMumError CMumRenderer::UnpackDataR8(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum)
-{
-    TMumBlockR8 *block = (TMumBlockR8 *)mPackedData;
-
-    memcpy(unpackedData, block->dataA, MUM_BLOCK_SIZE_A_R8);
-    memcpy(unpackedData + MUM_BLOCK_SIZE_A_R8, block->dataB, MUM_BLOCK_SIZE_B_R8);
-
-    uint32_t lengthField = block->length[0];
-    lengthField += block->length[1] << 8;
-    if (((lengthField & MUM_LENGTH_BLOCKTYPE_MASK) >> MUM_LENGTH_BLOCKTYPE_SHIFT) != MUM_BLOCKTYPE_1024)
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_BLOCKTYPE;
-    *length = (lengthField & MUM_LENGTH_LENGTH_MASK);
-    if (*length > MUM_ENCRYPT_SIZE_R8)
+    EncryptUpload(src);
+    for (uint32_t r = 0; r < mMumInfo->numRoundsPerBlock; r++)
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_LENGTH;
+        EncryptDiffuse(r);
+        EncryptConfuse(r);
     }
+    EncryptDownload(dst);
+}
 
-    uint32_t checksumA = block->checksum[0];
-    checksumA += block->checksum[1] << 8;
-    checksumA += block->checksum[2] << 16;
-    checksumA += block->checksum[3] << 24;
-    uint32_t checksumB = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R8);
-    if (checksumA != checksumB)
+void CMumRenderer::DecryptRounds(uint8_t *src, uint8_t *dst)
+{
+    DecryptUpload(src);
+    for (int r = mMumInfo->numRoundsPerBlock - 1; r >= 0; r--)
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_CHECKSUM;
+        DecryptConfuse((uint32_t)r);
+        DecryptDiffuse((uint32_t)r);
     }
-
-    *seqnum = block->seqnum[0];
-    *seqnum += block->seqnum[1] << 8;
-    return MUM_ERROR_OK;
+    // with block latency, the download during the wait is discarded
+    DecryptDownload(dst);
 }
 
-EMumError CMumRenderer::PackDataR4(uint8_t *unpackedData, uint32_t length, uint32_t seqnum)
+void CMumRenderer::EncryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride)
 {
-    TMumBlockR4 *block = (TMumBlockR4 *)mPackedData;
-
-    if (length > MUM_ENCRYPT_SIZE_R4)
-        return MUM_ERROR_INVALID_ENCRYPT_SIZE;
-
-    uint32_t checksum = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R4);
-
-    // first third of padding
-    memcpy(block->paddingA, &mPadding[0], 2);
-
-    // part A of data
-    memcpy(block->dataA, unpackedData, MUM_BLOCK_SIZE_A_R4);
-    unpackedData += MUM_BLOCK_SIZE_A_R4;
-
-    // second part of padding
-    memcpy(block->paddingB, &mPadding[2], 2);
-
-    block->checksum[0] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[1] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[2] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[3] = (uint8_t)checksum;
-    length += (MUM_BLOCKTYPE_512 << MUM_LENGTH_BLOCKTYPE_SHIFT);
-    block->length[0] = (uint8_t)(length % 256);
-    block->length[1] = (uint8_t)(length / 256);
-    block->seqnum[0] = (uint8_t)(seqnum % 256);
-    block->seqnum[1] = (uint8_t)(seqnum / 256);
-
-    // third part of padding
-    memcpy(block->paddingC, &mPadding[4], 2);
-
-    // second part of data
-    memcpy(block->dataB, unpackedData, MUM_BLOCK_SIZE_B_R4);
-
-    // fourth part of padding
-    memcpy(block->paddingD, &mPadding[6], 2);
-    return MUM_ERROR_OK;
+    for (uint32_t i = 0; i < BatchSize(); i++)
+        EncryptRounds(src + i * srcStride, dst + i * dstStride);
 }
 
-EMumError CMumRenderer::UnpackDataR4(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum)
+void CMumRenderer::DecryptRoundsBatch(uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride)
 {
-    TMumBlockR4 *block = (TMumBlockR4 *)mPackedData;
+    for (uint32_t i = 0; i < BatchSize(); i++)
+        DecryptRounds(src + i * srcStride, dst + i * dstStride);
+}
 
-    memcpy(unpackedData, block->dataA, MUM_BLOCK_SIZE_A_R4);
-    memcpy(unpackedData + MUM_BLOCK_SIZE_A_R4, block->dataB, MUM_BLOCK_SIZE_B_R4);
+// Copies size bytes, a multiple of 4, and returns the 32-bit sum of the
+// native-endian words copied. With USE_SIMD the bulk is SSE2, which every
+// x86-64 CPU has, so there is no CPUID check. Inlined so that the constant
+// sizes of each block geometry unroll.
+static inline uint32_t CopyChecksum(uint8_t *dst, const uint8_t *src, uint32_t size)
+{
+    uint32_t checksum = 0;
+    uint32_t i = 0;
+    uint32_t word;
 
-    uint32_t lengthField = block->length[0];
-    lengthField += block->length[1] << 8;
-    if (((lengthField & MUM_LENGTH_BLOCKTYPE_MASK) >> MUM_LENGTH_BLOCKTYPE_SHIFT) != MUM_BLOCKTYPE_512)
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_BLOCKTYPE;
-    *length = (lengthField & MUM_LENGTH_LENGTH_MASK);
-    if (*length > MUM_ENCRYPT_SIZE_R4)
+#ifdef USE_SIMD
+    __m128i sum0 = _mm_setzero_si128();
+    __m128i sum1 = _mm_setzero_si128();
+    for (; i + 32 <= size; i += 32)
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_LENGTH;
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(src + i + 16));
+        _mm_storeu_si128((__m128i *)(dst + i), v0);
+        _mm_storeu_si128((__m128i *)(dst + i + 16), v1);
+        sum0 = _mm_add_epi32(sum0, v0);
+        sum1 = _mm_add_epi32(sum1, v1);
     }
-
-    uint32_t checksumA = block->checksum[0];
-    checksumA += block->checksum[1] << 8;
-    checksumA += block->checksum[2] << 16;
-    checksumA += block->checksum[3] << 24;
-    uint32_t checksumB = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R4);
-    if (checksumA != checksumB)
+    if (i + 16 <= size)
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_CHECKSUM;
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), v0);
+        sum0 = _mm_add_epi32(sum0, v0);
+        i += 16;
     }
-
-    *seqnum = block->seqnum[0];
-    *seqnum += block->seqnum[1] << 8;
-    return MUM_ERROR_OK;
-}
-
-EMumError CMumRenderer::PackDataR2(uint8_t *unpackedData, uint32_t length, uint32_t seqnum)
-{
-    TMumBlockR2 *block = (TMumBlockR2 *)mPackedData;
-
-    if (length > MUM_ENCRYPT_SIZE_R2)
-        return MUM_ERROR_INVALID_ENCRYPT_SIZE;
-
-    uint32_t checksum = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R2);
-
-    // first third of padding
-    memcpy(block->paddingA, &mPadding[0], 2);
-
-    // part A of data
-    memcpy(block->dataA, unpackedData, MUM_BLOCK_SIZE_A_R2);
-    unpackedData += MUM_BLOCK_SIZE_A_R2;
-
-    // second part of padding
-    memcpy(block->paddingB, &mPadding[2], 2);
-
-    block->checksum[0] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[1] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[2] = (uint8_t)checksum;
-    checksum >>= 8;
-    block->checksum[3] = (uint8_t)checksum;
-    length += (MUM_BLOCKTYPE_256 << MUM_LENGTH_BLOCKTYPE_SHIFT);
-    block->length[0] = (uint8_t)(length % 256);
-    block->length[1] = (uint8_t)(length / 256);
-    block->seqnum[0] = (uint8_t)(seqnum % 256);
-    block->seqnum[1] = (uint8_t)(seqnum / 256);
-
-    // third part of padding
-    memcpy(block->paddingC, &mPadding[4], 2);
-
-    // second part of data
-    memcpy(block->dataB, unpackedData, MUM_BLOCK_SIZE_B_R2);
-
-    // fourth part of padding
-    memcpy(block->paddingD, &mPadding[6], 2);
-    return MUM_ERROR_OK;
+    sum0 = _mm_add_epi32(sum0, sum1);
+    sum0 = _mm_add_epi32(sum0, _mm_shuffle_epi32(sum0, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum0 = _mm_add_epi32(sum0, _mm_shuffle_epi32(sum0, _MM_SHUFFLE(2, 3, 0, 1)));
+    checksum = (uint32_t)_mm_cvtsi128_si32(sum0);
+#endif
+    for (; i < size; i += 4)
+    {
+        memcpy(&word, src + i, 4);
+        memcpy(dst + i, &word, 4);
+        checksum += word;
+    }
+    return checksum;
 }
 
-EMumError CMumRenderer::UnpackDataR2(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum)
+// Copies the two data pieces of a block between the packed layout and the
+// contiguous plaintext, and returns the checksum of the plaintext words as
+// it goes. When dataA does not end on a word, the word across the split is
+// summed from the plaintext side once both halves of it are in place.
+template <typename TGeometry, bool PACK>
+static inline uint32_t CopyData(uint8_t *dataA, uint8_t *dataB, uint8_t *plaintext)
 {
-    TMumBlockR2 *block = (TMumBlockR2 *)mPackedData;
+    const uint32_t head = TGeometry::sizeA & ~3u;
+    const uint32_t split = TGeometry::sizeA - head;
+    const uint32_t skip = split ? 4 - split : 0;
+    uint32_t checksum, word;
 
-    memcpy(unpackedData, block->dataA, MUM_BLOCK_SIZE_A_R2);
-    memcpy(unpackedData + MUM_BLOCK_SIZE_A_R2, block->dataB, MUM_BLOCK_SIZE_B_R2);
-
-    uint32_t lengthField = block->length[0];
-    lengthField += block->length[1] << 8;
-    if (((lengthField & MUM_LENGTH_BLOCKTYPE_MASK) >> MUM_LENGTH_BLOCKTYPE_SHIFT) != MUM_BLOCKTYPE_256)
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_BLOCKTYPE;
-    *length = (lengthField & MUM_LENGTH_LENGTH_MASK);
-    if (*length > MUM_ENCRYPT_SIZE_R2)
+    if (PACK)
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_LENGTH;
+        checksum = CopyChecksum(dataA, plaintext, head);
+        memcpy(dataA + head, plaintext + head, split);
+        memcpy(dataB, plaintext + TGeometry::sizeA, skip);
+        checksum += CopyChecksum(dataB + skip, plaintext + TGeometry::sizeA + skip, TGeometry::sizeB - skip);
     }
-
-    uint32_t checksumA = block->checksum[0];
-    checksumA += block->checksum[1] << 8;
-    checksumA += block->checksum[2] << 16;
-    checksumA += block->checksum[3] << 24;
-    uint32_t checksumB = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R2);
-    if (checksumA != checksumB)
+    else
     {
-        *length = 0;
-        return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_CHECKSUM;
+        checksum = CopyChecksum(plaintext, dataA, head);
+        memcpy(plaintext + head, dataA + head, split);
+        memcpy(plaintext + TGeometry::sizeA, dataB, skip);
+        checksum += CopyChecksum(plaintext + TGeometry::sizeA + skip, dataB + skip, TGeometry::sizeB - skip);
     }
-
-    *seqnum = block->seqnum[0];
-    *seqnum += block->seqnum[1] << 8;
-    return MUM_ERROR_OK;
+    if (split)
+    {
+        memcpy(&word, plaintext + head, 4);
+        checksum += word;
+    }
+    return checksum;
 }
 
-EMumError CMumRenderer::PackDataR1(uint8_t *unpackedData, uint32_t length, uint32_t seqnum)
+template <typename TGeometry>
+EMumError CMumRenderer::PackData(uint8_t *packedData, uint8_t *unpackedData, uint32_t length, uint32_t seqnum)
 {
-    TMumBlockR1 *block = (TMumBlockR1 *)mPackedData;
+    typename TGeometry::TLayout *block = (typename TGeometry::TLayout *)packedData;
+    uint8_t *padding = mPadding;
 
-    if (length > MUM_ENCRYPT_SIZE_R1)
+    if (length > TGeometry::encryptSize)
         return MUM_ERROR_INVALID_ENCRYPT_SIZE;
 
-    uint32_t checksum = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R1);
-
-    // first third of padding
-    memcpy(block->paddingA, &mPadding[0], 2);
+    uint32_t checksum = CopyData<TGeometry, true>(block->dataA, block->dataB, unpackedData);
 
-    // part A of data
-    memcpy(block->dataA, unpackedData, MUM_BLOCK_SIZE_A_R1);
-    unpackedData += MUM_BLOCK_SIZE_A_R1;
-
-    // second part of padding
-    memcpy(block->paddingB, &mPadding[2], 2);
+    // padding pieces in layout order
+    memcpy(block->paddingA, padding, sizeof(block->paddingA));
+    padding += sizeof(block->paddingA);
+    memcpy(block->paddingB, padding, sizeof(block->paddingB));
+    padding += sizeof(block->paddingB);
+    memcpy(block->paddingC, padding, sizeof(block->paddingC));
+    padding += sizeof(block->paddingC);
+    memcpy(block->paddingD, padding, sizeof(block->paddingD));
 
     block->checksum[0] = (uint8_t)checksum;
     checksum >>= 8;
@@ -658,36 +554,27 @@ EMumError CMumRenderer::PackDataR1(uint8_t *unpackedData, uint32_t length, uint3
     block->checksum[2] = (uint8_t)checksum;
     checksum >>= 8;
     block->checksum[3] = (uint8_t)checksum;
-    length += (MUM_BLOCKTYPE_128 << MUM_LENGTH_BLOCKTYPE_SHIFT);
+    length += (TGeometry::blockType << MUM_LENGTH_BLOCKTYPE_SHIFT);
     block->length[0] = (uint8_t)(length % 256);
     block->length[1] = (uint8_t)(length / 256);
     block->seqnum[0] = (uint8_t)(seqnum % 256);
     block->seqnum[1] = (uint8_t)(seqnum / 256);
-
-    // third part of padding
-    memcpy(block->paddingC, &mPadding[4], 2);
-
-    // second part of data
-    memcpy(block->dataB, unpackedData, MUM_BLOCK_SIZE_B_R1);
-
-    // fourth part of padding
-    memcpy(block->paddingD, &mPadding[6], 2);
     return MUM_ERROR_OK;
 }
 
-EMumError CMumRenderer::UnpackDataR1(uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum)
+template <typename TGeometry>
+EMumError CMumRenderer::UnpackData(uint8_t *packedData, uint8_t *unpackedData, uint32_t *length, uint32_t *seqnum)
 {
-    TMumBlockR1 *block = (TMumBlockR1 *)mPackedData;
+    typename TGeometry::TLayout *block = (typename TGeometry::TLayout *)packedData;
 
-    memcpy(unpackedData, block->dataA, MUM_BLOCK_SIZE_A_R1);
-    memcpy(unpackedData + MUM_BLOCK_SIZE_A_R1, block->dataB, MUM_BLOCK_SIZE_B_R1);
+    uint32_t checksumB = CopyData<TGeometry, false>(block->dataA, block->dataB, unpackedData);
 
     uint32_t lengthField = block->length[0];
     lengthField += block->length[1] << 8;
-    if (((lengthField & MUM_LENGTH_BLOCKTYPE_MASK) >> MUM_LENGTH_BLOCKTYPE_SHIFT) != MUM_BLOCKTYPE_128)
+    if (((lengthField & MUM_LENGTH_BLOCKTYPE_MASK) >> MUM_LENGTH_BLOCKTYPE_SHIFT) != TGeometry::blockType)
         return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_BLOCKTYPE;
     *length = (lengthField & MUM_LENGTH_LENGTH_MASK);
-    if (*length > MUM_ENCRYPT_SIZE_R1)
+    if (*length > TGeometry::encryptSize)
     {
         *length = 0;
         return MUM_ERROR_INVALID_ENCRYPTED_BLOCK_LENGTH;
@@ -697,7 +584,6 @@ EMumError CMumRenderer::UnpackDataR1(uint8_t *unpackedData, uint32_t *length, ui
     checksumA += block->checksum[1] << 8;
     checksumA += block->checksum[2] << 16;
     checksumA += block->checksum[3] << 24;
-    uint32_t checksumB = ComputeChecksum(unpackedData, MUM_ENCRYPT_SIZE_R1);
     if (checksumA != checksumB)
     {
         *length = 0;
@@ -709,15 +595,6 @@ EMumError CMumRenderer::UnpackDataR1(uint8_t *unpackedData, uint32_t *length, ui
     return MUM_ERROR_OK;
 }
 
-uint32_t CMumRenderer::ComputeChecksum(uint8_t *data, uint32_t size)
-{
-    uint32_t checksum = 0;
-    uint32_t *iptr = (uint32_t *)data;
-    for (uint32_t i = 0; i < size / 4; i++)
-        checksum += *iptr++;
-    return checksum;
-}
-
 void CMumRenderer::SetPadding(uint8_t *src, uint32_t length)
 {
     mPrng->Fetch(mPadding, mMumInfo->paddingSize);
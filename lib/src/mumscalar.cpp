@@ -0,0 +1,299 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumscalar.h"
+#include <assert.h>
+
+#define MUM_ROW_SIZE (MUM_CELLS_X * MUM_CELL_SIZE)
+
+template <uint32_t NUM_ROWS>
+static inline void EncryptDiffuse(TMumRoundSchedule *schedule, const uint8_t *src, uint8_t *dst)
+{
+    const uint32_t maskA = schedule->bitmasks[0];
+    const uint32_t maskB = schedule->bitmasks[1];
+    const uint32_t maskC = schedule->bitmasks[2];
+    const uint32_t maskD = schedule->bitmasks[3];
+    const uint16_t *gather = schedule->gather[0];
+
+    for (uint32_t n = 0; n < NUM_ROWS * MUM_CELLS_X; n++)
+    {
+        const uint8_t *mappedSrc1 = src + gather[n * 4 + 0];
+        const uint8_t *mappedSrc2 = src + gather[n * 4 + 1];
+        const uint8_t *mappedSrc3 = src + gather[n * 4 + 2];
+        const uint8_t *mappedSrc4 = src + gather[n * 4 + 3];
+        dst[n * 4 + 0] = (mappedSrc1[0] & maskA) + (mappedSrc2[2] & maskB) + (mappedSrc3[3] & maskC) + (mappedSrc4[1] & maskD);
+        dst[n * 4 + 1] = (mappedSrc1[2] & maskA) + (mappedSrc2[3] & maskB) + (mappedSrc3[1] & maskC) + (mappedSrc4[0] & maskD);
+        dst[n * 4 + 2] = (mappedSrc1[3] & maskA) + (mappedSrc2[1] & maskB) + (mappedSrc3[0] & maskC) + (mappedSrc4[2] & maskD);
+        dst[n * 4 + 3] = (mappedSrc1[1] & maskA) + (mappedSrc2[0] & maskB) + (mappedSrc3[2] & maskC) + (mappedSrc4[3] & maskD);
+    }
+}
+
+template <uint32_t NUM_ROWS>
+static inline void DecryptDiffuse(TMumRoundSchedule *schedule, const uint8_t *src, uint8_t *dst)
+{
+    const uint32_t maskA = schedule->bitmasks[0];
+    const uint32_t maskB = schedule->bitmasks[1];
+    const uint32_t maskC = schedule->bitmasks[2];
+    const uint32_t maskD = schedule->bitmasks[3];
+    const uint16_t *gather = schedule->gatherI[0];
+
+    for (uint32_t n = 0; n < NUM_ROWS * MUM_CELLS_X; n++)
+    {
+        const uint8_t *mappedSrc1 = src + gather[n * 4 + 0];
+        const uint8_t *mappedSrc2 = src + gather[n * 4 + 1];
+        const uint8_t *mappedSrc3 = src + gather[n * 4 + 2];
+        const uint8_t *mappedSrc4 = src + gather[n * 4 + 3];
+        dst[n * 4 + 0] = (mappedSrc1[0] & maskA) + (mappedSrc2[3] & maskB) + (mappedSrc3[2] & maskC) + (mappedSrc4[1] & maskD);
+        dst[n * 4 + 1] = (mappedSrc1[3] & maskA) + (mappedSrc2[2] & maskB) + (mappedSrc3[1] & maskC) + (mappedSrc4[0] & maskD);
+        dst[n * 4 + 2] = (mappedSrc1[1] & maskA) + (mappedSrc2[0] & maskB) + (mappedSrc3[3] & maskC) + (mappedSrc4[2] & maskD);
+        dst[n * 4 + 3] = (mappedSrc1[2] & maskA) + (mappedSrc2[1] & maskB) + (mappedSrc3[0] & maskC) + (mappedSrc4[3] & maskD);
+    }
+}
+
+template <uint32_t NUM_ROWS>
+static inline void EncryptConfuse(TMumRoundSchedule *schedule, const uint8_t *table, const uint8_t *src, uint8_t *dst)
+{
+    const uint8_t *clav = schedule->subkey;
+
+    if (table)
+    {
+        for (uint32_t x = 0; x < NUM_ROWS * MUM_ROW_SIZE; x++)
+            dst[x] = table[x * MUM_NUM_8BIT_VALUES + src[x]];
+        return;
+    }
+
+    for (uint32_t y = 0; y < NUM_ROWS; y++)
+    {
+        const uint8_t *prm = schedule->permute[y];
+        for (uint32_t x = y * MUM_ROW_SIZE; x < (y + 1) * MUM_ROW_SIZE; x++)
+            dst[x] = prm[(uint8_t)(src[x] ^ clav[x])];
+    }
+}
+
+template <uint32_t NUM_ROWS>
+static inline void DecryptConfuse(TMumRoundSchedule *schedule, const uint8_t *table, const uint8_t *src, uint8_t *dst)
+{
+    const uint8_t *clav = schedule->subkey;
+
+    if (table)
+    {
+        for (uint32_t x = 0; x < NUM_ROWS * MUM_ROW_SIZE; x++)
+            dst[x] = table[x * MUM_NUM_8BIT_VALUES + src[x]];
+        return;
+    }
+
+    for (uint32_t y = 0; y < NUM_ROWS; y++)
+    {
+        const uint8_t *prm = schedule->permuteI[y];
+        for (uint32_t x = y * MUM_ROW_SIZE; x < (y + 1) * MUM_ROW_SIZE; x++)
+            dst[x] = prm[src[x]] ^ clav[x];
+    }
+}
+
+// byte x of the block after diffuse, substituted; POSITION_TABLES selects
+// the table layout of the schedule
+template <bool POSITION_TABLES>
+static inline uint8_t Substitute(const uint8_t *table, const uint8_t *prm, const uint8_t *clav, uint32_t x, uint8_t value)
+{
+    if (POSITION_TABLES)
+        return table[x * MUM_NUM_8BIT_VALUES + value];
+    return prm[(uint8_t)(value ^ clav[x])];
+}
+
+template <bool POSITION_TABLES>
+static inline uint8_t SubstituteI(const uint8_t *table, const uint8_t *prm, const uint8_t *clav, uint32_t x, uint8_t value)
+{
+    if (POSITION_TABLES)
+        return table[x * MUM_NUM_8BIT_VALUES + value];
+    return prm[value] ^ clav[x];
+}
+
+template <uint32_t NUM_ROWS, bool POSITION_TABLES>
+static inline void EncryptRoundFused(TMumRoundSchedule *schedule, const uint8_t *table, const uint8_t *src, uint8_t *dst)
+{
+    const uint32_t maskA = schedule->bitmasks[0];
+    const uint32_t maskB = schedule->bitmasks[1];
+    const uint32_t maskC = schedule->bitmasks[2];
+    const uint32_t maskD = schedule->bitmasks[3];
+    const uint16_t *gather = schedule->gather[0];
+    const uint8_t *clav = schedule->subkey;
+
+    for (uint32_t y = 0; y < NUM_ROWS; y++)
+    {
+        const uint8_t *prm = schedule->permute[y];
+        for (uint32_t n = y * MUM_CELLS_X; n < (y + 1) * MUM_CELLS_X; n++)
+        {
+            const uint8_t *mappedSrc1 = src + gather[n * 4 + 0];
+            const uint8_t *mappedSrc2 = src + gather[n * 4 + 1];
+            const uint8_t *mappedSrc3 = src + gather[n * 4 + 2];
+            const uint8_t *mappedSrc4 = src + gather[n * 4 + 3];
+            uint8_t a = (mappedSrc1[0] & maskA) + (mappedSrc2[2] & maskB) + (mappedSrc3[3] & maskC) + (mappedSrc4[1] & maskD);
+            uint8_t b = (mappedSrc1[2] & maskA) + (mappedSrc2[3] & maskB) + (mappedSrc3[1] & maskC) + (mappedSrc4[0] & maskD);
+            uint8_t c = (mappedSrc1[3] & maskA) + (mappedSrc2[1] & maskB) + (mappedSrc3[0] & maskC) + (mappedSrc4[2] & maskD);
+            uint8_t d = (mappedSrc1[1] & maskA) + (mappedSrc2[0] & maskB) + (mappedSrc3[2] & maskC) + (mappedSrc4[3] & maskD);
+            dst[n * 4 + 0] = Substitute<POSITION_TABLES>(table, prm, clav, n * 4 + 0, a);
+            dst[n * 4 + 1] = Substitute<POSITION_TABLES>(table, prm, clav, n * 4 + 1, b);
+            dst[n * 4 + 2] = Substitute<POSITION_TABLES>(table, prm, clav, n * 4 + 2, c);
+            dst[n * 4 + 3] = Substitute<POSITION_TABLES>(table, prm, clav, n * 4 + 3, d);
+        }
+    }
+}
+
+// inverse diffuse of the round, then the inverse confuse of next, the
+// schedule of the round before it, with table its position tables
+template <uint32_t NUM_ROWS, bool POSITION_TABLES>
+static inline void DecryptRoundFused(TMumRoundSchedule *schedule, TMumRoundSchedule *next, const uint8_t *table,
+                                     const uint8_t *src, uint8_t *dst)
+{
+    const uint32_t maskA = schedule->bitmasks[0];
+    const uint32_t maskB = schedule->bitmasks[1];
+    const uint32_t maskC = schedule->bitmasks[2];
+    const uint32_t maskD = schedule->bitmasks[3];
+    const uint16_t *gather = schedule->gatherI[0];
+    const uint8_t *clav = next->subkey;
+
+    for (uint32_t y = 0; y < NUM_ROWS; y++)
+    {
+        const uint8_t *prm = next->permuteI[y];
+        for (uint32_t n = y * MUM_CELLS_X; n < (y + 1) * MUM_CELLS_X; n++)
+        {
+            const uint8_t *mappedSrc1 = src + gather[n * 4 + 0];
+            const uint8_t *mappedSrc2 = src + gather[n * 4 + 1];
+            const uint8_t *mappedSrc3 = src + gather[n * 4 + 2];
+            const uint8_t *mappedSrc4 = src + gather[n * 4 + 3];
+            uint8_t a = (mappedSrc1[0] & maskA) + (mappedSrc2[3] & maskB) + (mappedSrc3[2] & maskC) + (mappedSrc4[1] & maskD);
+            uint8_t b = (mappedSrc1[3] & maskA) + (mappedSrc2[2] & maskB) + (mappedSrc3[1] & maskC) + (mappedSrc4[0] & maskD);
+            uint8_t c = (mappedSrc1[1] & maskA) + (mappedSrc2[0] & maskB) + (mappedSrc3[3] & maskC) + (mappedSrc4[2] & maskD);
+            uint8_t d = (mappedSrc1[2] & maskA) + (mappedSrc2[1] & maskB) + (mappedSrc3[0] & maskC) + (mappedSrc4[3] & maskD);
+            dst[n * 4 + 0] = SubstituteI<POSITION_TABLES>(table, prm, clav, n * 4 + 0, a);
+            dst[n * 4 + 1] = SubstituteI<POSITION_TABLES>(table, prm, clav, n * 4 + 1, b);
+            dst[n * 4 + 2] = SubstituteI<POSITION_TABLES>(table, prm, clav, n * 4 + 2, c);
+            dst[n * 4 + 3] = SubstituteI<POSITION_TABLES>(table, prm, clav, n * 4 + 3, d);
+        }
+    }
+}
+
+// the first round reads src and the last writes dst, the rest stay in work0/1
+template <uint32_t NUM_ROWS>
+static void EncryptRoundsTwoPass(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1)
+{
+    for (uint32_t round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+        uint8_t *out = (round == MUM_NUM_ROUNDS - 1) ? dst : work0;
+        EncryptDiffuse<NUM_ROWS>(schedule, src, work1);
+        EncryptConfuse<NUM_ROWS>(schedule, mumInfo->positionPermute[round], work1, out);
+        src = out;
+    }
+}
+
+template <uint32_t NUM_ROWS>
+static void DecryptRoundsTwoPass(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1)
+{
+    for (int round = MUM_NUM_ROUNDS - 1; round >= 0; round--)
+    {
+        TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+        uint8_t *out = (round == 0) ? dst : work0;
+        DecryptConfuse<NUM_ROWS>(schedule, mumInfo->positionPermuteI[round], src, work1);
+        DecryptDiffuse<NUM_ROWS>(schedule, work1, out);
+        src = out;
+    }
+}
+
+template <uint32_t NUM_ROWS>
+static void EncryptRoundsFused(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1)
+{
+    uint8_t *work[2] = {work0, work1};
+
+    for (uint32_t round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+        uint8_t *out = (round == MUM_NUM_ROUNDS - 1) ? dst : work[round & 1];
+        const uint8_t *table = mumInfo->positionPermute[round];
+        if (table)
+            EncryptRoundFused<NUM_ROWS, true>(schedule, table, src, out);
+        else
+            EncryptRoundFused<NUM_ROWS, false>(schedule, table, src, out);
+        src = out;
+    }
+}
+
+template <uint32_t NUM_ROWS>
+static void DecryptRoundsFused(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst, uint8_t *work0, uint8_t *work1)
+{
+    uint8_t *work[2] = {work0, work1};
+
+    // the inverse confuse of the last round has no diffuse pass before it,
+    // and the inverse diffuse of round 0 no confuse after it
+    DecryptConfuse<NUM_ROWS>(&mumInfo->tables->schedule[MUM_NUM_ROUNDS - 1], mumInfo->positionPermuteI[MUM_NUM_ROUNDS - 1], src, work0);
+    src = work0;
+    for (uint32_t round = MUM_NUM_ROUNDS - 1; round > 0; round--)
+    {
+        TMumRoundSchedule *next = &mumInfo->tables->schedule[round - 1];
+        uint8_t *out = work[(MUM_NUM_ROUNDS - round) & 1];
+        const uint8_t *table = mumInfo->positionPermuteI[round - 1];
+        if (table)
+            DecryptRoundFused<NUM_ROWS, true>(&mumInfo->tables->schedule[round], next, table, src, out);
+        else
+            DecryptRoundFused<NUM_ROWS, false>(&mumInfo->tables->schedule[round], next, table, src, out);
+        src = out;
+    }
+    DecryptDiffuse<NUM_ROWS>(&mumInfo->tables->schedule[0], src, dst);
+}
+
+template <uint32_t NUM_ROWS>
+static void SelectScalarKernels(TMumInfo *mumInfo)
+{
+    mumInfo->encryptScalar = EncryptRoundsTwoPass<NUM_ROWS>;
+    mumInfo->decryptScalar = DecryptRoundsTwoPass<NUM_ROWS>;
+    mumInfo->encryptFusedScalar = EncryptRoundsFused<NUM_ROWS>;
+    mumInfo->decryptFusedScalar = DecryptRoundsFused<NUM_ROWS>;
+}
+
+void MumSelectScalarKernels(TMumInfo *mumInfo)
+{
+    switch (mumInfo->numRows)
+    {
+    case 1:
+        SelectScalarKernels<1>(mumInfo);
+        break;
+    case 2:
+        SelectScalarKernels<2>(mumInfo);
+        break;
+    case 4:
+        SelectScalarKernels<4>(mumInfo);
+        break;
+    case 8:
+        SelectScalarKernels<8>(mumInfo);
+        break;
+    case 16:
+        SelectScalarKernels<16>(mumInfo);
+        break;
+    case 32:
+        SelectScalarKernels<32>(mumInfo);
+        break;
+    default:
+        assert(0);
+    }
+}
@@ -0,0 +1,320 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumschedulefile.h"
+#include "mumkeycache.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint64_t AlignUp(uint64_t size)
+{
+    return (size + MUM_SCHEDULE_FILE_ALIGN - 1) & ~(uint64_t)(MUM_SCHEDULE_FILE_ALIGN - 1);
+}
+
+// FNV-1a style over 8-byte words, four independent lanes so the multiplies
+// overlap; sizes are multiples of 8
+static uint64_t Checksum(uint64_t checksum, const uint8_t *data, uint64_t size)
+{
+    uint64_t lanes[4] = {checksum, checksum ^ 1, checksum ^ 2, checksum ^ 3};
+    uint64_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            uint64_t word;
+            memcpy(&word, data + i + lane * 8, 8);
+            lanes[lane] = (lanes[lane] ^ word) * 0x100000001b3ull;
+        }
+    }
+    for (; i < size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        lanes[0] = (lanes[0] ^ word) * 0x100000001b3ull;
+    }
+    for (uint32_t lane = 0; lane < 4; lane++)
+        checksum = (checksum ^ lanes[lane]) * 0x100000001b3ull;
+    return checksum;
+}
+
+static bool WriteSection(int fd, const uint8_t *data, uint64_t offset, uint64_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = pwrite(fd, data, size, offset);
+        if (written <= 0)
+            return false;
+        data += written;
+        offset += written;
+        size -= written;
+    }
+    return true;
+}
+
+// the header of the tables of mumInfo, and its position tables if
+// positionTables; returns the file size
+static uint64_t InitHeader(TMumInfo *mumInfo, bool positionTables, TMumScheduleFileHeader *header)
+{
+    const uint8_t *tables = (const uint8_t *)mumInfo->tables;
+
+    static_assert(sizeof(TMumKeyTables) % 8 == 0, "schedule file sections are checksummed in 8-byte words");
+    memset(header, 0, sizeof(*header));
+    header->magic = MUM_SCHEDULE_FILE_MAGIC;
+    header->version = MUM_SCHEDULE_FILE_VERSION;
+    header->blockType = mumInfo->blockType;
+    header->tablesOffset = MUM_SCHEDULE_FILE_ALIGN;
+    header->tablesSize = sizeof(TMumKeyTables);
+    header->checksum = Checksum(0xcbf29ce484222325ull, tables, header->tablesSize);
+    uint64_t fileSize = header->tablesOffset + AlignUp(header->tablesSize);
+    if (positionTables && mumInfo->positionPermuteTables != nullptr)
+    {
+        header->positionTablesOffset = fileSize;
+        header->positionTablesSize = MumPositionTablesSize(mumInfo);
+        header->checksum = Checksum(header->checksum, mumInfo->positionPermuteTables, header->positionTablesSize);
+        fileSize += AlignUp(header->positionTablesSize);
+    }
+    return fileSize;
+}
+
+// the header goes last, so a reader never sees a valid header over tables
+// not yet written
+static EMumError WriteSections(TMumInfo *mumInfo, int fd)
+{
+    TMumScheduleFileHeader header;
+    uint64_t fileSize = InitHeader(mumInfo, true, &header);
+
+    if (ftruncate(fd, fileSize) != 0 ||
+        !WriteSection(fd, (const uint8_t *)mumInfo->tables, header.tablesOffset, header.tablesSize) ||
+        (header.positionTablesSize > 0 &&
+         !WriteSection(fd, mumInfo->positionPermuteTables, header.positionTablesOffset, header.positionTablesSize)) ||
+        !WriteSection(fd, (const uint8_t *)&header, 0, sizeof(header)))
+        return MUM_ERROR_SCHEDULEFILE_WRITE;
+    return MUM_ERROR_OK;
+}
+
+static EMumError MapSections(TMumInfo *mumInfo, int fd, TMumScheduleFile *scheduleFile)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < MUM_SCHEDULE_FILE_ALIGN)
+        return MUM_ERROR_SCHEDULEFILE_INVALID;
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return MUM_ERROR_SCHEDULEFILE_READ;
+
+    const uint8_t *data = (const uint8_t *)map;
+    uint64_t fileSize = st.st_size;
+    TMumScheduleFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    EMumError error = MUM_ERROR_OK;
+    if (header.magic != MUM_SCHEDULE_FILE_MAGIC || header.version != MUM_SCHEDULE_FILE_VERSION ||
+        header.tablesSize != sizeof(TMumKeyTables) || header.tablesOffset != MUM_SCHEDULE_FILE_ALIGN ||
+        header.tablesOffset + header.tablesSize > fileSize)
+        error = MUM_ERROR_SCHEDULEFILE_INVALID;
+    else if (header.positionTablesSize != 0 &&
+             (header.positionTablesSize != MumPositionTablesSize(mumInfo) ||
+              header.positionTablesOffset % MUM_SCHEDULE_FILE_ALIGN != 0 ||
+              header.positionTablesOffset + header.positionTablesSize > fileSize))
+        error = MUM_ERROR_SCHEDULEFILE_INVALID;
+    else if (header.blockType != (uint32_t)mumInfo->blockType)
+        error = MUM_ERROR_SCHEDULEFILE_BLOCKTYPE;
+    else
+    {
+        uint64_t checksum = Checksum(0xcbf29ce484222325ull, data + header.tablesOffset, header.tablesSize);
+        if (header.positionTablesSize != 0)
+            checksum = Checksum(checksum, data + header.positionTablesOffset, header.positionTablesSize);
+        if (checksum != header.checksum)
+            error = MUM_ERROR_SCHEDULEFILE_INVALID;
+    }
+    if (error != MUM_ERROR_OK)
+    {
+        munmap(map, st.st_size);
+        return error;
+    }
+
+    scheduleFile->map = map;
+    scheduleFile->mapSize = st.st_size;
+    scheduleFile->tables = (const TMumKeyTables *)(data + header.tablesOffset);
+    scheduleFile->positionPermuteTables = header.positionTablesSize != 0 ? data + header.positionTablesOffset : nullptr;
+    scheduleFile->lockFd = -1;
+    return MUM_ERROR_OK;
+}
+
+EMumError MumWriteScheduleFile(TMumInfo *mumInfo, const char *schedulefile)
+{
+    int fd = open(schedulefile, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return MUM_ERROR_SCHEDULEFILE_WRITE;
+    EMumError error = WriteSections(mumInfo, fd);
+    if (close(fd) != 0)
+        error = MUM_ERROR_SCHEDULEFILE_WRITE;
+    return error;
+}
+
+EMumError MumMapScheduleFile(TMumInfo *mumInfo, const char *schedulefile, TMumScheduleFile *scheduleFile)
+{
+    int fd = open(schedulefile, O_RDONLY);
+    if (fd < 0)
+        return MUM_ERROR_SCHEDULEFILE_READ;
+    EMumError error = MapSections(mumInfo, fd, scheduleFile);
+    close(fd);
+    if (error != MUM_ERROR_OK)
+        return error;
+
+    // attached read-only, so no subkey may be left to derive, see
+    // CMumEngine::Subkey; MumWriteScheduleFile writes them all
+    bool complete = true;
+    for (uint32_t s = 0; complete && s < MUM_NUM_SUBKEYS; s++)
+        complete = scheduleFile->tables->subkeyValid[s];
+    if (!complete)
+    {
+        MumUnmapScheduleFile(scheduleFile);
+        return MUM_ERROR_SCHEDULEFILE_INVALID;
+    }
+    return MUM_ERROR_OK;
+}
+
+void MumUnmapScheduleFile(TMumScheduleFile *scheduleFile)
+{
+    munmap(scheduleFile->map, scheduleFile->mapSize);
+    scheduleFile->map = nullptr;
+}
+
+// The segment name of the caller's name and blockType; false if name is
+// empty, too long or has a slash. Names are visible to every local user,
+// so nothing in them is derived from the key.
+static bool SharedScheduleName(EMumBlockType blockType, const char *name, char *segmentName, size_t length)
+{
+    size_t nameLength = name != nullptr ? strlen(name) : 0;
+    if (nameLength == 0 || nameLength > MUM_SHARED_SCHEDULE_NAME_MAX || strchr(name, '/') != nullptr)
+        return false;
+    snprintf(segmentName, length, "/mumblepad-%s-%d", name, (int)blockType);
+    return true;
+}
+
+EMumError MumCreateSharedSchedule(TMumInfo *mumInfo, const char *name, TMumScheduleFile *scheduleFile, TMumKeyTables **tables)
+{
+    char segmentName[MUM_SHARED_SCHEDULE_NAME_MAX + 32];
+    if (!SharedScheduleName(mumInfo->blockType, name, segmentName, sizeof(segmentName)))
+        return MUM_ERROR_SHAREDKEY_NAME;
+    int fd = shm_open(segmentName, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return MUM_ERROR_SHAREDKEY_CREATE;
+    // held until complete; released by the kernel if this process dies
+    flock(fd, LOCK_EX);
+    // reserved up front: tmpfs pages are otherwise only allocated when
+    // first written, and raise SIGBUS when it is full
+    size_t mapSize = MUM_SCHEDULE_FILE_ALIGN + AlignUp(sizeof(TMumKeyTables));
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, mapSize) == 0 && posix_fallocate(fd, 0, mapSize) == 0)
+        map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        shm_unlink(segmentName);
+        close(fd);
+        return MUM_ERROR_SHAREDKEY_CREATE;
+    }
+    scheduleFile->lockFd = fd;
+    scheduleFile->map = map;
+    scheduleFile->mapSize = mapSize;
+    *tables = (TMumKeyTables *)((uint8_t *)map + MUM_SCHEDULE_FILE_ALIGN);
+    scheduleFile->tables = *tables;
+    scheduleFile->positionPermuteTables = nullptr;
+    return MUM_ERROR_OK;
+}
+
+void MumCompleteSharedSchedule(TMumInfo *mumInfo, TMumScheduleFile *scheduleFile)
+{
+    TMumScheduleFileHeader header;
+    // attached engines build their own position tables
+    InitHeader(mumInfo, false, &header);
+    // the tables are in place before a reader can see the header
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(scheduleFile->map, &header, sizeof(header));
+    mprotect(scheduleFile->map, scheduleFile->mapSize, PROT_READ);
+    close(scheduleFile->lockFd);
+    scheduleFile->lockFd = -1;
+}
+
+// true if name is gone, or was still the segment of fd and is unlinked
+static bool UnlinkStaleSegment(const char *segmentName, int fd)
+{
+    struct stat stale, current;
+    int currentFd = shm_open(segmentName, O_RDONLY, 0);
+    if (currentFd < 0)
+        return true;
+    // republished meanwhile by another process
+    bool same = fstat(fd, &stale) == 0 && fstat(currentFd, &current) == 0 &&
+        stale.st_dev == current.st_dev && stale.st_ino == current.st_ino;
+    close(currentFd);
+    return same && (shm_unlink(segmentName) == 0 || errno == ENOENT);
+}
+
+EMumError MumMapSharedSchedule(TMumInfo *mumInfo, uint8_t *key, const char *name, TMumScheduleFile *scheduleFile)
+{
+    char segmentName[MUM_SHARED_SCHEDULE_NAME_MAX + 32];
+    if (!SharedScheduleName(mumInfo->blockType, name, segmentName, sizeof(segmentName)))
+        return MUM_ERROR_SHAREDKEY_NAME;
+    int fd = shm_open(segmentName, O_RDONLY, 0);
+    if (fd < 0)
+        return MUM_ERROR_SHAREDKEY_NOT_FOUND;
+    EMumError error = MapSections(mumInfo, fd, scheduleFile);
+    // without the lock of its publisher, checked again as it may just have
+    // completed
+    if (error == MUM_ERROR_SCHEDULEFILE_INVALID && flock(fd, LOCK_EX | LOCK_NB) == 0)
+    {
+        error = MapSections(mumInfo, fd, scheduleFile);
+        if (error == MUM_ERROR_SCHEDULEFILE_INVALID && UnlinkStaleSegment(segmentName, fd))
+            error = MUM_ERROR_SHAREDKEY_NOT_FOUND;
+    }
+    close(fd);
+    if (error != MUM_ERROR_OK)
+        return error;
+
+    // another key may have been published under the name; and the mapping
+    // is read-only, so no subkey may be left to derive, see CMumEngine::Subkey
+    const TMumKeyTables *tables = scheduleFile->tables;
+    bool complete = memcmp(tables->key, key, MUM_KEY_SIZE) == 0 && scheduleFile->positionPermuteTables == nullptr;
+    for (uint32_t s = 0; complete && s < MUM_NUM_SUBKEYS; s++)
+        complete = tables->subkeyValid[s];
+    if (!complete)
+    {
+        MumUnmapScheduleFile(scheduleFile);
+        return MUM_ERROR_SCHEDULEFILE_INVALID;
+    }
+    return MUM_ERROR_OK;
+}
+
+EMumError MumUnlinkSharedSchedule(EMumBlockType blockType, const char *name)
+{
+    char segmentName[MUM_SHARED_SCHEDULE_NAME_MAX + 32];
+    if (!SharedScheduleName(blockType, name, segmentName, sizeof(segmentName)))
+        return MUM_ERROR_SHAREDKEY_NAME;
+    return shm_unlink(segmentName) == 0 ? MUM_ERROR_OK : MUM_ERROR_SHAREDKEY_NOT_FOUND;
+}
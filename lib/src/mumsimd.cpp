@@ -0,0 +1,95 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "mumsimd.h"
+
+const uint8_t mumEncryptSourceBytes[MUM_NUM_POSITIONS][MUM_CELL_SIZE] = {
+    {0, 2, 3, 1},
+    {2, 3, 1, 0},
+    {3, 1, 0, 2},
+    {1, 0, 2, 3}};
+
+const uint8_t mumDecryptSourceBytes[MUM_NUM_POSITIONS][MUM_CELL_SIZE] = {
+    {0, 3, 1, 2},
+    {3, 2, 0, 1},
+    {2, 1, 3, 0},
+    {1, 0, 2, 3}};
+
+bool MumKernelTypeSupported(EMumKernelType kernelType, EMumBlockType blockType)
+{
+    switch (kernelType)
+    {
+    case MUM_KERNEL_TYPE_AUTO:
+    case MUM_KERNEL_TYPE_SCALAR:
+        return true;
+#ifdef USE_SIMD
+    case MUM_KERNEL_TYPE_SSSE3:
+        return __builtin_cpu_supports("ssse3");
+    case MUM_KERNEL_TYPE_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case MUM_KERNEL_TYPE_AVX512VBMI:
+        return blockType == MUM_BLOCKTYPE_128 &&
+               __builtin_cpu_supports("avx512f") &&
+               __builtin_cpu_supports("avx512bw") &&
+               __builtin_cpu_supports("avx512vbmi");
+#endif
+    default:
+        return false;
+    }
+}
+
+EMumKernelType MumBestKernelType(EMumBlockType blockType)
+{
+    if (MumKernelTypeSupported(MUM_KERNEL_TYPE_AVX512VBMI, blockType))
+        return MUM_KERNEL_TYPE_AVX512VBMI;
+    if (MumKernelTypeSupported(MUM_KERNEL_TYPE_AVX2, blockType))
+        return MUM_KERNEL_TYPE_AVX2;
+    if (MumKernelTypeSupported(MUM_KERNEL_TYPE_SSSE3, blockType))
+        return MUM_KERNEL_TYPE_SSSE3;
+    return MUM_KERNEL_TYPE_SCALAR;
+}
+
+void MumInitVbmiTables(TMumInfo *mumInfo)
+{
+    uint32_t round, n, position, i;
+
+    for (round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        for (n = 0; n < MUM_CELLS_X; n++)
+        {
+            for (position = 0; position < MUM_NUM_POSITIONS; position++)
+            {
+                uint32_t offset = mumInfo->tables->schedule[round].gather[n][position];
+                uint32_t offsetI = mumInfo->tables->schedule[round].gatherI[n][position];
+                for (i = 0; i < MUM_CELL_SIZE; i++)
+                {
+                    mumInfo->tables->vbmiDiffuseIndex[round][position][n * MUM_CELL_SIZE + i] =
+                        (uint8_t)(offset + mumEncryptSourceBytes[position][i]);
+                    mumInfo->tables->vbmiDiffuseIndexI[round][position][n * MUM_CELL_SIZE + i] =
+                        (uint8_t)(offsetI + mumDecryptSourceBytes[position][i]);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,356 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <immintrin.h>
+#include <string.h>
+#include "mumsimd.h"
+
+// Each gathered vector holds two cells, one 32-bit source word per position.
+// These shuffles put the bytes of each source word in the order the
+// scalar kernels combine them, so that a position only needs its own mask.
+static inline __m256i EncryptShuffle()
+{
+    return _mm256_setr_epi8(
+        0, 2, 3, 1, 6, 7, 5, 4, 11, 9, 8, 10, 13, 12, 14, 15,
+        0, 2, 3, 1, 6, 7, 5, 4, 11, 9, 8, 10, 13, 12, 14, 15);
+}
+
+static inline __m256i DecryptShuffle()
+{
+    return _mm256_setr_epi8(
+        0, 3, 1, 2, 7, 6, 4, 5, 10, 9, 11, 8, 13, 12, 14, 15,
+        0, 3, 1, 2, 7, 6, 4, 5, 10, 9, 11, 8, 13, 12, 14, 15);
+}
+
+static inline __m256i BitmaskVector(uint8_t *bitmasks)
+{
+    uint32_t a = bitmasks[0] * 0x01010101;
+    uint32_t b = bitmasks[1] * 0x01010101;
+    uint32_t c = bitmasks[2] * 0x01010101;
+    uint32_t d = bitmasks[3] * 0x01010101;
+    return _mm256_setr_epi32(a, b, c, d, a, b, c, d);
+}
+
+// Gathers the four source words for two cells, starting at the cell whose
+// gather entries (byte offsets) are at gather.
+static inline __m256i GatherCells(uint8_t *src, uint16_t *gather, __m256i shuffle, __m256i masks)
+{
+    __m256i offsets = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i *)gather));
+    __m256i cells = _mm256_i32gather_epi32((const int *)src, offsets, 1);
+    return _mm256_and_si256(_mm256_shuffle_epi8(cells, shuffle), masks);
+}
+
+// ORs the four masked positions of each cell together. Input vectors hold
+// cells (0,1), (2,3), (4,5), (6,7); the result holds cells 0 to 7 in order.
+static inline __m256i CombinePositions(__m256i v0, __m256i v1, __m256i v2, __m256i v3)
+{
+    __m256i u = _mm256_or_si256(_mm256_unpacklo_epi32(v0, v1), _mm256_unpackhi_epi32(v0, v1));
+    __m256i w = _mm256_or_si256(_mm256_unpacklo_epi32(v2, v3), _mm256_unpackhi_epi32(v2, v3));
+    __m256i r = _mm256_or_si256(_mm256_unpacklo_epi64(u, w), _mm256_unpackhi_epi64(u, w));
+    return _mm256_permutevar8x32_epi32(r, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+// the diffused values of the eight cells whose gather entries start at gather
+static inline __m256i DiffuseCells(uint8_t *src, uint16_t *gather, __m256i shuffle, __m256i masks)
+{
+    __m256i v0 = GatherCells(src, gather + 0, shuffle, masks);
+    __m256i v1 = GatherCells(src, gather + 8, shuffle, masks);
+    __m256i v2 = GatherCells(src, gather + 16, shuffle, masks);
+    __m256i v3 = GatherCells(src, gather + 24, shuffle, masks);
+    return CombinePositions(v0, v1, v2, v3);
+}
+
+static inline void DiffuseAvx2(uint32_t numCells, uint16_t *gather, uint8_t *bitmasks,
+                               __m256i shuffle, uint8_t *src, uint8_t *dst)
+{
+    __m256i masks = BitmaskVector(bitmasks);
+
+    for (uint32_t n = 0; n < numCells; n += 8)
+    {
+        _mm256_storeu_si256((__m256i *)dst, DiffuseCells(src, gather, shuffle, masks));
+        gather += 8 * MUM_NUM_POSITIONS;
+        dst += 8 * MUM_CELL_SIZE;
+    }
+}
+
+void MumEncryptDiffuseAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    DiffuseAvx2(mumInfo->numRows * MUM_CELLS_X, schedule->gather[0], schedule->bitmasks, EncryptShuffle(), src, dst);
+}
+
+void MumDecryptDiffuseAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    DiffuseAvx2(mumInfo->numRows * MUM_CELLS_X, schedule->gatherI[0], schedule->bitmasks, DecryptShuffle(), src, dst);
+}
+
+// 256-entry lookup of 32 indices; table is one confuse table row
+static inline __m256i SubstituteAvx2(__m256i value, uint8_t *table)
+{
+    __m256i nibbleMask = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_and_si256(value, nibbleMask);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(value, 4), nibbleMask);
+    __m256i result = _mm256_setzero_si256();
+
+    for (int slice = 0; slice < 16; slice++)
+    {
+        __m256i entries = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)(table + slice * 16)));
+        __m256i selected = _mm256_cmpeq_epi8(high, _mm256_set1_epi8((char)slice));
+        result = _mm256_or_si256(result, _mm256_and_si256(_mm256_shuffle_epi8(entries, low), selected));
+    }
+    return result;
+}
+
+void MumEncryptConfuseAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint8_t *clav = schedule->subkey;
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = schedule->permute[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X * MUM_CELL_SIZE; x += 32)
+        {
+            __m256i value = _mm256_xor_si256(_mm256_loadu_si256((__m256i *)src), _mm256_loadu_si256((__m256i *)clav));
+            _mm256_storeu_si256((__m256i *)dst, SubstituteAvx2(value, table));
+            src += 32;
+            dst += 32;
+            clav += 32;
+        }
+    }
+}
+
+void MumDecryptConfuseAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint8_t *clav = schedule->subkey;
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = schedule->permuteI[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X * MUM_CELL_SIZE; x += 32)
+        {
+            __m256i value = SubstituteAvx2(_mm256_loadu_si256((__m256i *)src), table);
+            _mm256_storeu_si256((__m256i *)dst, _mm256_xor_si256(value, _mm256_loadu_si256((__m256i *)clav)));
+            src += 32;
+            dst += 32;
+            clav += 32;
+        }
+    }
+}
+
+void MumEncryptRoundFusedAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint16_t *gather = schedule->gather[0];
+    uint8_t *clav = schedule->subkey;
+    __m256i masks = BitmaskVector(schedule->bitmasks);
+    __m256i shuffle = EncryptShuffle();
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = schedule->permute[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X; x += 8)
+        {
+            __m256i value = DiffuseCells(src, gather, shuffle, masks);
+            value = _mm256_xor_si256(value, _mm256_loadu_si256((__m256i *)clav));
+            _mm256_storeu_si256((__m256i *)dst, SubstituteAvx2(value, table));
+            gather += 8 * MUM_NUM_POSITIONS;
+            clav += 8 * MUM_CELL_SIZE;
+            dst += 8 * MUM_CELL_SIZE;
+        }
+    }
+}
+
+void MumDecryptRoundFusedAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    if (round == 0)
+    {
+        MumDecryptDiffuseAvx2(mumInfo, round, src, dst);
+        return;
+    }
+
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    TMumRoundSchedule *next = &mumInfo->tables->schedule[round - 1];
+    uint16_t *gather = schedule->gatherI[0];
+    uint8_t *clav = next->subkey;
+    __m256i masks = BitmaskVector(schedule->bitmasks);
+    __m256i shuffle = DecryptShuffle();
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = next->permuteI[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X; x += 8)
+        {
+            __m256i value = SubstituteAvx2(DiffuseCells(src, gather, shuffle, masks), table);
+            value = _mm256_xor_si256(value, _mm256_loadu_si256((__m256i *)clav));
+            _mm256_storeu_si256((__m256i *)dst, value);
+            gather += 8 * MUM_NUM_POSITIONS;
+            clav += 8 * MUM_CELL_SIZE;
+            dst += 8 * MUM_CELL_SIZE;
+        }
+    }
+}
+
+// Batch rounds, see MumEncryptBatch. Bytes 0,1 and bytes 2,3 of a cell share
+// a permutation row, so each pair is computed in the two halves of one
+// vector and substituted together.
+static inline __m256i GatherLanePair(uint8_t *src, uint32_t offsetLow, uint32_t offsetHigh, __m256i mask)
+{
+    __m256i value = _mm256_loadu2_m128i((__m128i *)(src + offsetHigh * MUM_BATCH_BLOCKS),
+                                        (__m128i *)(src + offsetLow * MUM_BATCH_BLOCKS));
+    return _mm256_and_si256(value, mask);
+}
+
+static inline __m256i DiffuseLanePair(uint8_t *src, uint16_t *gather, const uint8_t (*sourceBytes)[MUM_CELL_SIZE],
+                                      uint32_t i, __m256i *masks)
+{
+    __m256i a = GatherLanePair(src, gather[0] + sourceBytes[0][i], gather[0] + sourceBytes[0][i + 1], masks[0]);
+    __m256i b = GatherLanePair(src, gather[1] + sourceBytes[1][i], gather[1] + sourceBytes[1][i + 1], masks[1]);
+    __m256i c = GatherLanePair(src, gather[2] + sourceBytes[2][i], gather[2] + sourceBytes[2][i + 1], masks[2]);
+    __m256i d = GatherLanePair(src, gather[3] + sourceBytes[3][i], gather[3] + sourceBytes[3][i + 1], masks[3]);
+    return _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+}
+
+static inline __m256i SubkeyPair(uint8_t *clav)
+{
+    return _mm256_setr_m128i(_mm_set1_epi8((char)clav[0]), _mm_set1_epi8((char)clav[1]));
+}
+
+static inline void BatchMasks(uint8_t *bitmasks, __m256i *masks)
+{
+    for (int position = 0; position < MUM_NUM_POSITIONS; position++)
+        masks[position] = _mm256_set1_epi8((char)bitmasks[position]);
+}
+
+void MumEncryptRoundBatchAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint16_t *gather = schedule->gather[0];
+    uint8_t *clav = schedule->subkey;
+    __m256i masks[MUM_NUM_POSITIONS];
+
+    BatchMasks(schedule->bitmasks, masks);
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = schedule->permute[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X; x++)
+        {
+            for (uint32_t i = 0; i < MUM_CELL_SIZE; i += 2)
+            {
+                __m256i value = DiffuseLanePair(src, gather, mumEncryptSourceBytes, i, masks);
+                value = _mm256_xor_si256(value, SubkeyPair(clav + i));
+                _mm256_storeu_si256((__m256i *)dst, SubstituteAvx2(value, table));
+                dst += 2 * MUM_BATCH_BLOCKS;
+            }
+            gather += MUM_NUM_POSITIONS;
+            clav += MUM_CELL_SIZE;
+        }
+    }
+}
+
+void MumDecryptConfuseBatchAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *data)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint8_t *clav = schedule->subkey;
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = schedule->permuteI[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X * MUM_CELL_SIZE; x += 2)
+        {
+            __m256i value = SubstituteAvx2(_mm256_loadu_si256((__m256i *)data), table);
+            _mm256_storeu_si256((__m256i *)data, _mm256_xor_si256(value, SubkeyPair(clav)));
+            data += 2 * MUM_BATCH_BLOCKS;
+            clav += 2;
+        }
+    }
+}
+
+void MumDecryptRoundBatchAvx2(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    TMumRoundSchedule *next = (round > 0) ? &mumInfo->tables->schedule[round - 1] : nullptr;
+    uint16_t *gather = schedule->gatherI[0];
+    uint8_t *clav = next ? next->subkey : nullptr;
+    __m256i masks[MUM_NUM_POSITIONS];
+
+    BatchMasks(schedule->bitmasks, masks);
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = next ? next->permuteI[y] : nullptr;
+        for (uint32_t x = 0; x < MUM_CELLS_X; x++)
+        {
+            for (uint32_t i = 0; i < MUM_CELL_SIZE; i += 2)
+            {
+                __m256i value = DiffuseLanePair(src, gather, mumDecryptSourceBytes, i, masks);
+                if (next)
+                    value = _mm256_xor_si256(SubstituteAvx2(value, table), SubkeyPair(clav + i));
+                _mm256_storeu_si256((__m256i *)dst, value);
+                dst += 2 * MUM_BATCH_BLOCKS;
+            }
+            gather += MUM_NUM_POSITIONS;
+            if (next)
+                clav += MUM_CELL_SIZE;
+        }
+    }
+}
+
+void MumXorPrimeCyclesAvx2(uint8_t *key, uint32_t *primes, uint32_t *offsets, uint8_t *subkey)
+{
+    // the 32-bit gathers read up to 3 bytes past a byte offset
+    uint8_t paddedKey[MUM_KEY_SIZE + 4];
+    memcpy(paddedKey, key, MUM_KEY_SIZE);
+    memset(paddedKey + MUM_KEY_SIZE, 0, 4);
+
+    const __m256i keyMask = _mm256_set1_epi32(MUM_KEY_MASK);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    // byte 0 of each 32-bit lane to bytes 0..3 of each 128-bit half
+    const __m256i lowBytes = _mm256_setr_epi8(
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m256i offset[MUM_NUM_CYCLES];
+    __m256i step[MUM_NUM_CYCLES];
+    for (uint32_t c = 0; c < MUM_NUM_CYCLES; c++)
+    {
+        offset[c] = _mm256_add_epi32(_mm256_set1_epi32(offsets[c]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(primes[c])));
+        step[c] = _mm256_set1_epi32(primes[c] * 8);
+    }
+    for (uint32_t i = 0; i < MUM_KEY_SIZE; i += 8)
+    {
+        __m256i value = _mm256_setzero_si256();
+        for (uint32_t c = 0; c < MUM_NUM_CYCLES; c++)
+        {
+            __m256i index = _mm256_and_si256(offset[c], keyMask);
+            value = _mm256_xor_si256(value, _mm256_i32gather_epi32((const int *)paddedKey, index, 1));
+            offset[c] = _mm256_add_epi32(offset[c], step[c]);
+        }
+        value = _mm256_shuffle_epi8(value, lowBytes);
+        uint32_t low = (uint32_t)_mm256_extract_epi32(value, 0);
+        uint32_t high = (uint32_t)_mm256_extract_epi32(value, 4);
+        memcpy(subkey + i, &low, 4);
+        memcpy(subkey + i + 4, &high, 4);
+    }
+}
@@ -0,0 +1,111 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <immintrin.h>
+#include "mumsimd.h"
+
+// A 128-byte block is held as two 64-byte halves, lo and hi. vpermi2b
+// picks any of its 128 bytes using the low 7 bits of each index byte.
+
+typedef struct TMumVbmiBlock
+{
+    __m512i lo;
+    __m512i hi;
+} TMumVbmiBlock;
+
+static inline __m512i GatherMasked(TMumVbmiBlock &block, uint8_t *index, uint8_t mask)
+{
+    __m512i gathered = _mm512_permutex2var_epi8(block.lo, _mm512_loadu_si512(index), block.hi);
+    return _mm512_and_si512(gathered, _mm512_set1_epi8((char)mask));
+}
+
+static inline TMumVbmiBlock Diffuse(TMumVbmiBlock &block, uint8_t (*index)[MUM_BLOCK_SIZE_R1], uint8_t *bitmasks)
+{
+    TMumVbmiBlock out;
+    out.lo = _mm512_or_si512(
+        _mm512_or_si512(GatherMasked(block, index[0], bitmasks[0]), GatherMasked(block, index[1], bitmasks[1])),
+        _mm512_or_si512(GatherMasked(block, index[2], bitmasks[2]), GatherMasked(block, index[3], bitmasks[3])));
+    out.hi = _mm512_or_si512(
+        _mm512_or_si512(GatherMasked(block, index[0] + 64, bitmasks[0]), GatherMasked(block, index[1] + 64, bitmasks[1])),
+        _mm512_or_si512(GatherMasked(block, index[2] + 64, bitmasks[2]), GatherMasked(block, index[3] + 64, bitmasks[3])));
+    return out;
+}
+
+// 256-entry lookup: two 128-byte lookups, picked by the top bit of each byte
+static inline __m512i Substitute(__m512i value, __m512i t0, __m512i t1, __m512i t2, __m512i t3)
+{
+    __m512i low = _mm512_permutex2var_epi8(t0, value, t1);
+    __m512i high = _mm512_permutex2var_epi8(t2, value, t3);
+    return _mm512_mask_blend_epi8(_mm512_movepi8_mask(value), low, high);
+}
+
+static inline void SubstituteBlock(TMumVbmiBlock &block, uint8_t *table)
+{
+    __m512i t0 = _mm512_loadu_si512(table);
+    __m512i t1 = _mm512_loadu_si512(table + 64);
+    __m512i t2 = _mm512_loadu_si512(table + 128);
+    __m512i t3 = _mm512_loadu_si512(table + 192);
+    block.lo = Substitute(block.lo, t0, t1, t2, t3);
+    block.hi = Substitute(block.hi, t0, t1, t2, t3);
+}
+
+static inline void XorSubkey(TMumVbmiBlock &block, uint8_t *subkey)
+{
+    block.lo = _mm512_xor_si512(block.lo, _mm512_loadu_si512(subkey));
+    block.hi = _mm512_xor_si512(block.hi, _mm512_loadu_si512(subkey + 64));
+}
+
+void MumEncryptBlockVbmi(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst)
+{
+    TMumVbmiBlock block;
+    block.lo = _mm512_loadu_si512(src);
+    block.hi = _mm512_loadu_si512(src + 64);
+
+    for (uint32_t round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        block = Diffuse(block, mumInfo->tables->vbmiDiffuseIndex[round], mumInfo->tables->schedule[round].bitmasks);
+        XorSubkey(block, mumInfo->tables->schedule[round].subkey);
+        SubstituteBlock(block, mumInfo->tables->schedule[round].permute[0]);
+    }
+
+    _mm512_storeu_si512(dst, block.lo);
+    _mm512_storeu_si512(dst + 64, block.hi);
+}
+
+void MumDecryptBlockVbmi(TMumInfo *mumInfo, uint8_t *src, uint8_t *dst)
+{
+    TMumVbmiBlock block;
+    block.lo = _mm512_loadu_si512(src);
+    block.hi = _mm512_loadu_si512(src + 64);
+
+    for (int round = MUM_NUM_ROUNDS - 1; round >= 0; round--)
+    {
+        SubstituteBlock(block, mumInfo->tables->schedule[round].permuteI[0]);
+        XorSubkey(block, mumInfo->tables->schedule[round].subkey);
+        block = Diffuse(block, mumInfo->tables->vbmiDiffuseIndexI[round], mumInfo->tables->schedule[round].bitmasks);
+    }
+
+    _mm512_storeu_si512(dst, block.lo);
+    _mm512_storeu_si512(dst + 64, block.hi);
+}
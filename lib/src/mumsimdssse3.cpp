@@ -0,0 +1,259 @@
+//
+// MIT License
+//
+// Copyright (c) 2022 Kyle Granger
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <tmmintrin.h>
+#include "mumsimd.h"
+
+// 256-entry lookup of 16 indices; table is one confuse table row
+static inline __m128i SubstituteSsse3(__m128i value, uint8_t *table)
+{
+    __m128i nibbleMask = _mm_set1_epi8(0x0f);
+    __m128i low = _mm_and_si128(value, nibbleMask);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(value, 4), nibbleMask);
+    __m128i result = _mm_setzero_si128();
+
+    for (int slice = 0; slice < 16; slice++)
+    {
+        __m128i entries = _mm_loadu_si128((__m128i *)(table + slice * 16));
+        __m128i selected = _mm_cmpeq_epi8(high, _mm_set1_epi8((char)slice));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_shuffle_epi8(entries, low), selected));
+    }
+    return result;
+}
+
+void MumEncryptConfuseSsse3(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint8_t *clav = schedule->subkey;
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = schedule->permute[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X * MUM_CELL_SIZE; x += 16)
+        {
+            __m128i value = _mm_xor_si128(_mm_loadu_si128((__m128i *)src), _mm_loadu_si128((__m128i *)clav));
+            _mm_storeu_si128((__m128i *)dst, SubstituteSsse3(value, table));
+            src += 16;
+            dst += 16;
+            clav += 16;
+        }
+    }
+}
+
+void MumDecryptConfuseSsse3(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint8_t *clav = schedule->subkey;
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = schedule->permuteI[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X * MUM_CELL_SIZE; x += 16)
+        {
+            __m128i value = SubstituteSsse3(_mm_loadu_si128((__m128i *)src), table);
+            _mm_storeu_si128((__m128i *)dst, _mm_xor_si128(value, _mm_loadu_si128((__m128i *)clav)));
+            src += 16;
+            dst += 16;
+            clav += 16;
+        }
+    }
+}
+
+static_assert(MUM_BATCH_BLOCKS == 16, "the batch kernels keep one block per byte lane");
+
+// rows i of r become columns i
+static inline void Transpose16x16(__m128i *r)
+{
+    __m128i t[16];
+    for (int stage = 0; stage < 4; stage++)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            t[2 * i] = _mm_unpacklo_epi8(r[i], r[i + 8]);
+            t[2 * i + 1] = _mm_unpackhi_epi8(r[i], r[i + 8]);
+        }
+        for (int i = 0; i < 16; i++)
+            r[i] = t[i];
+    }
+}
+
+static void TransposeIn(uint8_t *src, uint32_t stride, uint32_t size, uint8_t *soa)
+{
+    __m128i r[16];
+    for (uint32_t n = 0; n < size; n += 16)
+    {
+        for (int i = 0; i < 16; i++)
+            r[i] = _mm_loadu_si128((__m128i *)(src + i * stride + n));
+        Transpose16x16(r);
+        for (int i = 0; i < 16; i++)
+            _mm_storeu_si128((__m128i *)(soa + (n + i) * MUM_BATCH_BLOCKS), r[i]);
+    }
+}
+
+static void TransposeOut(uint8_t *soa, uint8_t *dst, uint32_t stride, uint32_t size)
+{
+    __m128i r[16];
+    for (uint32_t n = 0; n < size; n += 16)
+    {
+        for (int i = 0; i < 16; i++)
+            r[i] = _mm_loadu_si128((__m128i *)(soa + (n + i) * MUM_BATCH_BLOCKS));
+        Transpose16x16(r);
+        for (int i = 0; i < 16; i++)
+            _mm_storeu_si128((__m128i *)(dst + i * stride + n), r[i]);
+    }
+}
+
+// byte offset of the source byte in the batch, masked
+static inline __m128i GatherLanes(uint8_t *src, uint32_t offset, __m128i mask)
+{
+    return _mm_and_si128(_mm_loadu_si128((__m128i *)(src + offset * MUM_BATCH_BLOCKS)), mask);
+}
+
+static void EncryptRoundBatch(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint16_t *gather = schedule->gather[0];
+    uint8_t *clav = schedule->subkey;
+    __m128i maskA = _mm_set1_epi8((char)schedule->bitmasks[0]);
+    __m128i maskB = _mm_set1_epi8((char)schedule->bitmasks[1]);
+    __m128i maskC = _mm_set1_epi8((char)schedule->bitmasks[2]);
+    __m128i maskD = _mm_set1_epi8((char)schedule->bitmasks[3]);
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = schedule->permute[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X; x++)
+        {
+            for (uint32_t i = 0; i < MUM_CELL_SIZE; i++)
+            {
+                __m128i value = _mm_or_si128(
+                    _mm_or_si128(GatherLanes(src, gather[0] + mumEncryptSourceBytes[0][i], maskA),
+                                 GatherLanes(src, gather[1] + mumEncryptSourceBytes[1][i], maskB)),
+                    _mm_or_si128(GatherLanes(src, gather[2] + mumEncryptSourceBytes[2][i], maskC),
+                                 GatherLanes(src, gather[3] + mumEncryptSourceBytes[3][i], maskD)));
+                value = _mm_xor_si128(value, _mm_set1_epi8((char)clav[i]));
+                _mm_storeu_si128((__m128i *)dst, SubstituteSsse3(value, table));
+                dst += MUM_BATCH_BLOCKS;
+            }
+            gather += MUM_NUM_POSITIONS;
+            clav += MUM_CELL_SIZE;
+        }
+    }
+}
+
+static void DecryptConfuseBatch(TMumInfo *mumInfo, uint32_t round, uint8_t *data)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    uint8_t *clav = schedule->subkey;
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = schedule->permuteI[y];
+        for (uint32_t x = 0; x < MUM_CELLS_X * MUM_CELL_SIZE; x++)
+        {
+            __m128i value = SubstituteSsse3(_mm_loadu_si128((__m128i *)data), table);
+            _mm_storeu_si128((__m128i *)data, _mm_xor_si128(value, _mm_set1_epi8((char)*clav++)));
+            data += MUM_BATCH_BLOCKS;
+        }
+    }
+}
+
+// inverse diffuse of round, then inverse confuse of round - 1 if there is one
+static void DecryptRoundBatch(TMumInfo *mumInfo, uint32_t round, uint8_t *src, uint8_t *dst)
+{
+    TMumRoundSchedule *schedule = &mumInfo->tables->schedule[round];
+    TMumRoundSchedule *next = (round > 0) ? &mumInfo->tables->schedule[round - 1] : nullptr;
+    uint16_t *gather = schedule->gatherI[0];
+    uint8_t *clav = next ? next->subkey : nullptr;
+    __m128i maskA = _mm_set1_epi8((char)schedule->bitmasks[0]);
+    __m128i maskB = _mm_set1_epi8((char)schedule->bitmasks[1]);
+    __m128i maskC = _mm_set1_epi8((char)schedule->bitmasks[2]);
+    __m128i maskD = _mm_set1_epi8((char)schedule->bitmasks[3]);
+
+    for (uint32_t y = 0; y < mumInfo->numRows; y++)
+    {
+        uint8_t *table = next ? next->permuteI[y] : nullptr;
+        for (uint32_t x = 0; x < MUM_CELLS_X; x++)
+        {
+            for (uint32_t i = 0; i < MUM_CELL_SIZE; i++)
+            {
+                __m128i value = _mm_or_si128(
+                    _mm_or_si128(GatherLanes(src, gather[0] + mumDecryptSourceBytes[0][i], maskA),
+                                 GatherLanes(src, gather[1] + mumDecryptSourceBytes[1][i], maskB)),
+                    _mm_or_si128(GatherLanes(src, gather[2] + mumDecryptSourceBytes[2][i], maskC),
+                                 GatherLanes(src, gather[3] + mumDecryptSourceBytes[3][i], maskD)));
+                if (next)
+                    value = _mm_xor_si128(SubstituteSsse3(value, table), _mm_set1_epi8((char)clav[i]));
+                _mm_storeu_si128((__m128i *)dst, value);
+                dst += MUM_BATCH_BLOCKS;
+            }
+            gather += MUM_NUM_POSITIONS;
+            if (next)
+                clav += MUM_CELL_SIZE;
+        }
+    }
+}
+
+static inline bool UseAvx2(TMumInfo *mumInfo)
+{
+    return mumInfo->kernelType == MUM_KERNEL_TYPE_AVX2 || mumInfo->kernelType == MUM_KERNEL_TYPE_AVX512VBMI;
+}
+
+void MumEncryptBatch(TMumInfo *mumInfo, uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride,
+                     uint8_t *work0, uint8_t *work1)
+{
+    TransposeIn(src, srcStride, mumInfo->encryptedBlockSize, work0);
+    for (uint32_t round = 0; round < MUM_NUM_ROUNDS; round++)
+    {
+        if (UseAvx2(mumInfo))
+            MumEncryptRoundBatchAvx2(mumInfo, round, work0, work1);
+        else
+            EncryptRoundBatch(mumInfo, round, work0, work1);
+        uint8_t *swap = work0;
+        work0 = work1;
+        work1 = swap;
+    }
+    TransposeOut(work0, dst, dstStride, mumInfo->encryptedBlockSize);
+}
+
+void MumDecryptBatch(TMumInfo *mumInfo, uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride,
+                     uint8_t *work0, uint8_t *work1)
+{
+    TransposeIn(src, srcStride, mumInfo->encryptedBlockSize, work0);
+    if (UseAvx2(mumInfo))
+        MumDecryptConfuseBatchAvx2(mumInfo, MUM_NUM_ROUNDS - 1, work0);
+    else
+        DecryptConfuseBatch(mumInfo, MUM_NUM_ROUNDS - 1, work0);
+    for (int round = MUM_NUM_ROUNDS - 1; round >= 0; round--)
+    {
+        if (UseAvx2(mumInfo))
+            MumDecryptRoundBatchAvx2(mumInfo, (uint32_t)round, work0, work1);
+        else
+            DecryptRoundBatch(mumInfo, (uint32_t)round, work0, work1);
+        uint8_t *swap = work0;
+        work0 = work1;
+        work1 = swap;
+    }
+    TransposeOut(work0, dst, dstStride, mumInfo->encryptedBlockSize);
+}
@@ -52,10 +52,11 @@ void printUsage() {
     printf("         (encrypted name), to derive original file name\n");
     printf("      -k <key-file> : required\n");
 #ifdef USE_OPENGL
-    printf("      -e <engine-type> :: [ cpu | mt | gl | gl8 ]\n");
-    printf("         single-threaded, multi-threaded, OpenGL single stage, OpenGL with 8 stages\n");
+    printf("      -e <engine-type> :: [ cpu | mt | bitslice | gl | gl8 ]\n");
+    printf("         single-threaded, multi-threaded, bitsliced, OpenGL single stage, OpenGL with 8 stages\n");
 #else
-    printf("      -e <engine-type> :: [ cpu | mt ]\n");
+    printf("      -e <engine-type> :: [ cpu | mt | bitslice ]\n");
+    printf("         single-threaded, multi-threaded, bitsliced\n");
 #endif
     printf("         is optional, default is cpu\n");
     printf("      -b <block-size>  : [ 128 | 256 | 512 | 1024 | 2048 | 4096 ]\n");
@@ -132,6 +133,9 @@ bool parseCommandLine(int argc, char *argv[], TJob &job) {
         } else if (engine.compare("mt") == 0) {
             job.engineType = MUM_ENGINE_TYPE_CPU_MT;
             printf("engine type is MUM_ENGINE_TYPE_CPU_MT\n");
+        } else if (engine.compare("bitslice") == 0) {
+            job.engineType = MUM_ENGINE_TYPE_CPU_BITSLICE;
+            printf("engine type is MUM_ENGINE_TYPE_CPU_BITSLICE\n");
 #ifdef USE_OPENGL
         } else if (engine.compare("gl") == 0) {
             job.engineType = MUM_ENGINE_TYPE_GPU_A;
@@ -28,7 +28,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <mumpublic.h>
+#include <mumalloc.h>
 
 #define NUM_TEST_FILES 2
 #define NUM_ENTROPY_ITERATIONS 5000
@@ -63,13 +70,14 @@ std::string testfileD[NUM_TEST_FILES] = {
 std::string keyfile = "testfiles/key.bin";
 
 #ifdef USE_OPENGL
-#define TEST_NUM_ENGINES 4
+#define TEST_NUM_ENGINES 5
 #else
-#define TEST_NUM_ENGINES 2
+#define TEST_NUM_ENGINES 3
 #endif
 EMumEngineType engineList[TEST_NUM_ENGINES] = {
     MUM_ENGINE_TYPE_CPU,
     MUM_ENGINE_TYPE_CPU_MT,
+    MUM_ENGINE_TYPE_CPU_BITSLICE,
 #ifdef USE_OPENGL
     MUM_ENGINE_TYPE_GPU_A,
     MUM_ENGINE_TYPE_GPU_B,
@@ -80,6 +88,7 @@ EMumEngineType engineList[TEST_NUM_ENGINES] = {
 EMumBlockType firstTestBlockTypeList[TEST_NUM_ENGINES] = {
     MUM_BLOCKTYPE_128,
     MUM_BLOCKTYPE_128,
+    MUM_BLOCKTYPE_128,
 #ifdef USE_OPENGL
     MUM_BLOCKTYPE_1024,
     MUM_BLOCKTYPE_4096
@@ -90,6 +99,7 @@ EMumBlockType firstTestBlockTypeList[TEST_NUM_ENGINES] = {
 EMumBlockType firstProfilingBlockTypeList[TEST_NUM_ENGINES] = {
     MUM_BLOCKTYPE_128,
     MUM_BLOCKTYPE_128,
+    MUM_BLOCKTYPE_128,
 #ifdef USE_OPENGL
     MUM_BLOCKTYPE_1024,
     MUM_BLOCKTYPE_4096
@@ -100,15 +110,48 @@ EMumBlockType firstProfilingBlockTypeList[TEST_NUM_ENGINES] = {
 uint32_t largeBlockSize[TEST_NUM_ENGINES] = {
     MAX_TEST_SIZE / 4,
     MAX_TEST_SIZE,
+    MAX_TEST_SIZE / 4,
 #ifdef USE_OPENGL
     MAX_TEST_SIZE / 16,
     MAX_TEST_SIZE / 16
 #endif
 };
 
+// every kernel type must produce the same blocks as the scalar kernel
+#define TEST_NUM_KERNEL_TYPES 4
+EMumKernelType kernelTypeList[TEST_NUM_KERNEL_TYPES] = {
+    MUM_KERNEL_TYPE_SCALAR,
+    MUM_KERNEL_TYPE_SSSE3,
+    MUM_KERNEL_TYPE_AVX2,
+    MUM_KERNEL_TYPE_AVX512VBMI,
+};
+
+std::string kernelName[TEST_NUM_KERNEL_TYPES] = {
+    "scalar",
+    "ssse3",
+    "avx2",
+    "avx512vbmi",
+};
+
+#define TEST_NUM_KERNEL_MODES 4
+EMumKernelMode kernelModeList[TEST_NUM_KERNEL_MODES] = {
+    MUM_KERNEL_MODE_TWO_PASS,
+    MUM_KERNEL_MODE_FUSED,
+    MUM_KERNEL_MODE_BATCH,
+    MUM_KERNEL_MODE_JIT,
+};
+
+std::string kernelModeName[TEST_NUM_KERNEL_MODES] = {
+    "two-pass",
+    "fused",
+    "batch",
+    "jit",
+};
+
 std::string engineName[TEST_NUM_ENGINES] = {
     "CPU-engine",
     "CPU-MT-engine",
+    "CPU-bitslice-engine",
 #ifdef USE_OPENGL
     "GPU-A-engine",
     "GPU-B-engine",
@@ -584,6 +627,460 @@ bool testSimpleBlocks(void *engine, char *engineDesc)
     return true;
 }
 
+// Encrypts with one kernel type and decrypts with the scalar kernel, and the
+// other way around. Since decryption is a bijection, a successful round trip
+// means both kernels produced identical blocks.
+bool testKernelTypes(void *engine, char *engineDesc)
+{
+    EMumError error;
+    uint32_t plaintextBlockSize;
+    error = MumPlaintextBlockSize(engine, &plaintextBlockSize);
+
+    // enough blocks for two full batches and a remainder
+    uint32_t plaintextSize = plaintextBlockSize * 40 - 5;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    bool success = true;
+
+    for (int k = 0; k < TEST_NUM_KERNEL_TYPES * TEST_NUM_KERNEL_MODES && success; k++)
+    {
+        EMumKernelType kernelType = kernelTypeList[k % TEST_NUM_KERNEL_TYPES];
+        EMumKernelMode kernelMode = kernelModeList[k / TEST_NUM_KERNEL_TYPES];
+        std::string kernelDesc = kernelName[k % TEST_NUM_KERNEL_TYPES] + ":" + kernelModeName[k / TEST_NUM_KERNEL_TYPES];
+
+        if (MumSetKernelType(engine, kernelType) != MUM_ERROR_OK || MumSetKernelMode(engine, kernelMode) != MUM_ERROR_OK)
+        {
+            printf("   kernel %s not supported, engine %s\n", kernelDesc.c_str(), engineDesc);
+            continue;
+        }
+        // the reference is the scalar two-pass kernel
+        for (int direction = 0; direction < 2 && success; direction++)
+        {
+            uint32_t encryptedLen = 0;
+            uint32_t decryptedLen = 0;
+
+            fillRandomly(plaintext, plaintextSize);
+            MumSetKernelType(engine, direction ? MUM_KERNEL_TYPE_SCALAR : kernelType);
+            MumSetKernelMode(engine, direction ? MUM_KERNEL_MODE_TWO_PASS : kernelMode);
+            error = MumEncrypt(engine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+            if (error == MUM_ERROR_OK)
+            {
+                MumSetKernelType(engine, direction ? kernelType : MUM_KERNEL_TYPE_SCALAR);
+                MumSetKernelMode(engine, direction ? kernelMode : MUM_KERNEL_MODE_TWO_PASS);
+                error = MumDecrypt(engine, encrypt, decrypt, encryptedLen, &decryptedLen);
+            }
+            if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+            {
+                printf("FAILED testKernelTypes, engine %s, kernel %s, error %d\n", engineDesc, kernelDesc.c_str(), error);
+                success = false;
+            }
+        }
+    }
+    MumSetKernelType(engine, MUM_KERNEL_TYPE_AUTO);
+    MumSetKernelMode(engine, MUM_KERNEL_MODE_TWO_PASS);
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    if (success)
+        printf("SUCCESS testKernelTypes, engine %s\n", engineDesc);
+    return success;
+}
+
+// the scalar kernels on position tables against the same on row tables
+bool testScheduleTypes(void *engine, char *engineDesc)
+{
+    EMumError error;
+    uint32_t plaintextBlockSize;
+    error = MumPlaintextBlockSize(engine, &plaintextBlockSize);
+
+    uint32_t plaintextSize = plaintextBlockSize * 8 - 5;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    bool success = true;
+    bool supported = true;
+
+    if (MumSetScheduleType(engine, MUM_SCHEDULE_TYPE_POSITION_TABLES) != MUM_ERROR_OK)
+    {
+        printf("   schedule type position-tables not supported, engine %s\n", engineDesc);
+        supported = false;
+    }
+    MumSetKernelType(engine, MUM_KERNEL_TYPE_SCALAR);
+    for (int k = 0; k < 2 * 2 && success && supported; k++)
+    {
+        EMumKernelMode kernelMode = kernelModeList[k / 2];
+        EMumScheduleType first = (k % 2) ? MUM_SCHEDULE_TYPE_ROW_TABLES : MUM_SCHEDULE_TYPE_POSITION_TABLES;
+        EMumScheduleType second = (k % 2) ? MUM_SCHEDULE_TYPE_POSITION_TABLES : MUM_SCHEDULE_TYPE_ROW_TABLES;
+        uint32_t encryptedLen = 0;
+        uint32_t decryptedLen = 0;
+
+        fillRandomly(plaintext, plaintextSize);
+        MumSetKernelMode(engine, kernelMode);
+        MumSetScheduleType(engine, first);
+        error = MumEncrypt(engine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+        if (error == MUM_ERROR_OK)
+        {
+            MumSetScheduleType(engine, second);
+            error = MumDecrypt(engine, encrypt, decrypt, encryptedLen, &decryptedLen);
+        }
+        if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+        {
+            printf("FAILED testScheduleTypes, engine %s, mode %s, error %d\n", engineDesc, kernelModeName[k / 2].c_str(), error);
+            success = false;
+        }
+    }
+    MumSetScheduleType(engine, MUM_SCHEDULE_TYPE_AUTO);
+    MumSetKernelType(engine, MUM_KERNEL_TYPE_AUTO);
+    MumSetKernelMode(engine, MUM_KERNEL_MODE_TWO_PASS);
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    if (success)
+        printf("SUCCESS testScheduleTypes, engine %s\n", engineDesc);
+    return success;
+}
+
+// contexts of one engine encrypt and decrypt concurrently, and the engine
+// itself decrypts what they produce
+bool testContexts(void *engine, char *engineDesc)
+{
+    const int numContexts = 4;
+    const int numPasses = 16;
+    uint32_t plaintextBlockSize;
+    MumPlaintextBlockSize(engine, &plaintextBlockSize);
+
+    void *contexts[numContexts];
+    for (int c = 0; c < numContexts; c++)
+        contexts[c] = MumCreateContext(engine);
+    if (contexts[0] == NULL)
+    {
+        printf("   contexts not supported, engine %s\n", engineDesc);
+        return true;
+    }
+
+    uint32_t plaintextSize = plaintextBlockSize * 8 - 5;
+    uint8_t *plaintext[numContexts];
+    uint8_t *encrypt[numContexts];
+    uint8_t *decrypt[numContexts];
+    uint32_t encryptedLen[numContexts];
+    bool passed[numContexts];
+    for (int c = 0; c < numContexts; c++)
+    {
+        plaintext[c] = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+        encrypt[c] = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+        decrypt[c] = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+        fillRandomly(plaintext[c], plaintextSize);
+    }
+
+    std::thread threads[numContexts];
+    for (int c = 0; c < numContexts; c++)
+    {
+        threads[c] = std::thread([&, c]() {
+            passed[c] = true;
+            for (int pass = 0; pass < numPasses && passed[c]; pass++)
+            {
+                uint32_t decryptedLen = 0;
+                EMumError error = MumContextEncrypt(contexts[c], plaintext[c], encrypt[c], plaintextSize, &encryptedLen[c], pass);
+                if (error == MUM_ERROR_OK)
+                    error = MumContextDecrypt(contexts[c], encrypt[c], decrypt[c], encryptedLen[c], &decryptedLen);
+                passed[c] = error == MUM_ERROR_OK && decryptedLen == plaintextSize &&
+                    blockChecker(plaintext[c], decrypt[c], plaintextSize);
+            }
+        });
+    }
+
+    bool success = true;
+    for (int c = 0; c < numContexts; c++)
+    {
+        threads[c].join();
+        uint32_t decryptedLen = 0;
+        memset(decrypt[c], 0, plaintextSize);
+        EMumError error = MumDecrypt(engine, encrypt[c], decrypt[c], encryptedLen[c], &decryptedLen);
+        if (!passed[c] || error != MUM_ERROR_OK || decryptedLen != plaintextSize ||
+            !blockChecker(plaintext[c], decrypt[c], plaintextSize))
+        {
+            printf("FAILED testContexts, engine %s, context %d\n", engineDesc, c);
+            success = false;
+        }
+        MumDestroyContext(contexts[c]);
+        delete[] plaintext[c];
+        delete[] encrypt[c];
+        delete[] decrypt[c];
+    }
+    if (success)
+        printf("SUCCESS testContexts, engine %s\n", engineDesc);
+    return success;
+}
+
+// contexts 1 and 17, which share a PRNG subkey set, and the engine's own
+// renderer pad the same plaintext differently
+bool testContextStreams()
+{
+    const int numContexts = 17;
+    uint8_t clavier[MUM_KEY_SIZE];
+    bool success = true;
+
+    fillRandomly(clavier, MUM_KEY_SIZE);
+    void *engine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, MUM_BLOCKTYPE_256, MUM_PADDING_TYPE_ON, 1);
+    MumInitKey(engine, clavier);
+    uint32_t plaintextBlockSize;
+    MumPlaintextBlockSize(engine, &plaintextBlockSize);
+    uint32_t plaintextSize = plaintextBlockSize * 2 - 9;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt[3];
+    uint32_t encryptedLen[3];
+    for (int e = 0; e < 3; e++)
+        encrypt[e] = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    fillRandomly(plaintext, plaintextSize);
+
+    void *contexts[numContexts];
+    for (int c = 0; c < numContexts; c++)
+        contexts[c] = MumCreateContext(engine);
+    EMumError error = MumContextEncrypt(contexts[0], plaintext, encrypt[0], plaintextSize, &encryptedLen[0], 0);
+    if (error == MUM_ERROR_OK)
+        error = MumContextEncrypt(contexts[numContexts - 1], plaintext, encrypt[1], plaintextSize, &encryptedLen[1], 0);
+    if (error == MUM_ERROR_OK)
+        error = MumEncrypt(engine, plaintext, encrypt[2], plaintextSize, &encryptedLen[2], 0);
+    for (int e = 0; e < 3 && error == MUM_ERROR_OK; e++)
+    {
+        uint32_t decryptedLen = 0;
+        error = MumDecrypt(engine, encrypt[e], decrypt, encryptedLen[e], &decryptedLen);
+        if (error == MUM_ERROR_OK && (decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize)))
+            error = MUM_ERROR_INVALID_ENCRYPTED_BLOCK;
+    }
+    if (error != MUM_ERROR_OK || encryptedLen[0] != encryptedLen[1] ||
+        !memcmp(encrypt[0], encrypt[1], encryptedLen[0]) || !memcmp(encrypt[1], encrypt[2], encryptedLen[1]) ||
+        !memcmp(encrypt[0], encrypt[2], encryptedLen[0]))
+    {
+        printf("FAILED testContextStreams, error %d\n", error);
+        success = false;
+    }
+
+    for (int c = 0; c < numContexts; c++)
+        MumDestroyContext(contexts[c]);
+    for (int e = 0; e < 3; e++)
+        delete[] encrypt[e];
+    delete[] plaintext;
+    delete[] decrypt;
+    MumDestroyEngine(engine);
+    if (success)
+        printf("SUCCESS testContextStreams\n");
+    return success;
+}
+
+// a saved key schedule decrypts after another key was loaded, and a
+// corrupted one is refused
+bool testKeySchedule(void *engine, char *engineDesc)
+{
+    const char *scheduleFile = "testfiles/keySchedule";
+    uint8_t otherKey[MUM_KEY_SIZE];
+    uint32_t plaintextBlockSize;
+    MumPlaintextBlockSize(engine, &plaintextBlockSize);
+
+    uint32_t plaintextSize = plaintextBlockSize * 4 - 3;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint32_t encryptedLen = 0;
+    uint32_t decryptedLen = 0;
+    bool success = true;
+
+    fillRandomly(plaintext, plaintextSize);
+    EMumError error = MumSaveKeySchedule(engine, scheduleFile);
+    if (error == MUM_ERROR_OK)
+        error = MumEncrypt(engine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+    fillRandomly(otherKey, MUM_KEY_SIZE);
+    MumInitKey(engine, otherKey);
+    if (error == MUM_ERROR_OK)
+        error = MumLoadKeySchedule(engine, scheduleFile);
+    if (error == MUM_ERROR_OK)
+        error = MumDecrypt(engine, encrypt, decrypt, encryptedLen, &decryptedLen);
+    if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+    {
+        printf("FAILED testKeySchedule, engine %s, error %d\n", engineDesc, error);
+        success = false;
+    }
+
+    // flip one byte of the tables
+    FILE *f = fopen(scheduleFile, "r+b");
+    if (f)
+    {
+        uint8_t value;
+        fseek(f, 4096 + MUM_KEY_SIZE * 7, SEEK_SET);
+        fread(&value, 1, 1, f);
+        value ^= 0x10;
+        fseek(f, 4096 + MUM_KEY_SIZE * 7, SEEK_SET);
+        fwrite(&value, 1, 1, f);
+        fclose(f);
+    }
+    if (MumLoadKeySchedule(engine, scheduleFile) != MUM_ERROR_SCHEDULEFILE_INVALID)
+    {
+        printf("FAILED testKeySchedule, engine %s, corrupted file loaded\n", engineDesc);
+        success = false;
+    }
+    remove(scheduleFile);
+
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    if (success)
+        printf("SUCCESS testKeySchedule, engine %s\n", engineDesc);
+    return success;
+}
+
+// the engine publishes its key, a second engine attaches it; the engine
+// stays attached for the tests after this one. An engine with another key
+// falls back to a private schedule.
+bool testSharedKey(void *engine, char *engineDesc, uint8_t *clavier, EMumBlockType blockType, EMumPaddingType paddingType)
+{
+    const char *name = "test";
+    uint8_t otherKey[MUM_KEY_SIZE];
+    uint32_t plaintextBlockSize;
+    MumPlaintextBlockSize(engine, &plaintextBlockSize);
+
+    uint32_t plaintextSize = plaintextBlockSize * 4 - 3;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    void *cpuEngine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, blockType, paddingType, 1);
+    void *otherEngine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, blockType, paddingType, 1);
+    uint32_t encryptedLen = 0;
+    uint32_t decryptedLen = 0;
+    bool success = true;
+
+    // left over by an earlier run
+    MumUnlinkSharedKey(blockType, name);
+    fillRandomly(plaintext, plaintextSize);
+    fillRandomly(otherKey, MUM_KEY_SIZE);
+    EMumError error = MumInitSharedKey(engine, clavier, name);
+    if (error == MUM_ERROR_OK)
+        error = MumInitSharedKey(cpuEngine, clavier, name);
+    if (error == MUM_ERROR_OK && MumInitSharedKey(otherEngine, otherKey, name) != MUM_ERROR_SHAREDKEY_PRIVATE)
+        error = MUM_ERROR_SHAREDKEY_NOT_FOUND;
+    if (error == MUM_ERROR_OK)
+        error = MumSetScheduleType(cpuEngine, MUM_SCHEDULE_TYPE_POSITION_TABLES);
+    if (error == MUM_ERROR_OK)
+        error = MumEncrypt(engine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+    if (error == MUM_ERROR_OK)
+        error = MumUnlinkSharedKey(blockType, name);
+    if (error == MUM_ERROR_OK)
+        error = MumDecrypt(cpuEngine, encrypt, decrypt, encryptedLen, &decryptedLen);
+    if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+    {
+        printf("FAILED testSharedKey, engine %s, error %d\n", engineDesc, error);
+        success = false;
+    }
+    if (MumUnlinkSharedKey(blockType, name) != MUM_ERROR_SHAREDKEY_NOT_FOUND)
+    {
+        printf("FAILED testSharedKey, engine %s, segment not unlinked\n", engineDesc);
+        success = false;
+    }
+    if (MumInitSharedKey(otherEngine, otherKey, "a/b") != MUM_ERROR_SHAREDKEY_NAME ||
+        MumUnlinkSharedKey(blockType, "") != MUM_ERROR_SHAREDKEY_NAME)
+    {
+        printf("FAILED testSharedKey, engine %s, invalid name accepted\n", engineDesc);
+        success = false;
+    }
+
+    MumDestroyEngine(cpuEngine);
+    MumDestroyEngine(otherEngine);
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    if (success)
+        printf("SUCCESS testSharedKey, engine %s\n", engineDesc);
+    return success;
+}
+
+// a segment left without a header by a publisher that died is published
+// again; one whose publisher still holds its lock is left alone
+bool testStaleSharedKey()
+{
+    const char *name = "test-stale";
+    const char *segmentName = "/mumblepad-test-stale-3";
+    uint8_t clavier[MUM_KEY_SIZE];
+    bool success = true;
+
+    fillRandomly(clavier, MUM_KEY_SIZE);
+    void *engine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, MUM_BLOCKTYPE_512, MUM_PADDING_TYPE_ON, 1);
+    void *otherEngine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, MUM_BLOCKTYPE_512, MUM_PADDING_TYPE_ON, 1);
+    MumUnlinkSharedKey(MUM_BLOCKTYPE_512, name);
+
+    // being written: its publisher holds the lock
+    int fd = shm_open(segmentName, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 || flock(fd, LOCK_EX) != 0 || ftruncate(fd, 1 << 20) != 0)
+    {
+        printf("FAILED testStaleSharedKey, no shared memory\n");
+        success = false;
+    }
+    else if (MumInitSharedKey(engine, clavier, name) != MUM_ERROR_SHAREDKEY_PRIVATE)
+    {
+        printf("FAILED testStaleSharedKey, segment being written attached\n");
+        success = false;
+    }
+
+    // its publisher died
+    if (fd >= 0)
+        close(fd);
+    EMumError error = MumInitSharedKey(engine, clavier, name);
+    if (error == MUM_ERROR_OK)
+        error = MumInitSharedKey(otherEngine, clavier, name);
+    if (error != MUM_ERROR_OK)
+    {
+        printf("FAILED testStaleSharedKey, stale segment not published again, error %d\n", error);
+        success = false;
+    }
+    MumUnlinkSharedKey(MUM_BLOCKTYPE_512, name);
+
+    MumDestroyEngine(engine);
+    MumDestroyEngine(otherEngine);
+    if (success)
+        printf("SUCCESS testStaleSharedKey\n");
+    return success;
+}
+
+// blocks from any engine must decrypt with the CPU engine, and back
+bool testCpuEngineInterop(void *engine, char *engineDesc, uint8_t *clavier, EMumBlockType blockType, EMumPaddingType paddingType)
+{
+    EMumError error;
+    uint32_t plaintextBlockSize;
+    error = MumPlaintextBlockSize(engine, &plaintextBlockSize);
+
+    // enough blocks for two full bitslice batches and a remainder
+    uint32_t plaintextSize = plaintextBlockSize * 140 - 5;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    void *cpuEngine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, blockType, paddingType, 1);
+    bool success = true;
+
+    MumInitKey(cpuEngine, clavier);
+    for (int direction = 0; direction < 2 && success; direction++)
+    {
+        uint32_t encryptedLen = 0;
+        uint32_t decryptedLen = 0;
+
+        fillRandomly(plaintext, plaintextSize);
+        error = MumEncrypt(direction ? cpuEngine : engine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+        if (error == MUM_ERROR_OK)
+            error = MumDecrypt(direction ? engine : cpuEngine, encrypt, decrypt, encryptedLen, &decryptedLen);
+        if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+        {
+            printf("FAILED testCpuEngineInterop, engine %s, direction %d, error %d\n", engineDesc, direction, error);
+            success = false;
+        }
+    }
+    MumDestroyEngine(cpuEngine);
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    if (success)
+        printf("SUCCESS testCpuEngineInterop, engine %s\n", engineDesc);
+    return success;
+}
+
 bool testUnitializedEngine(void *engine, char *engineDesc)
 {
     EMumError error;
@@ -746,6 +1243,30 @@ void doTest(void *engine, char *engineDesc, EMumPaddingType paddingType, EMumBlo
     {
         printf("failed testSimpleBlocks\n");
     }
+    if (!testKernelTypes(engine, engineDesc))
+    {
+        printf("failed testKernelTypes\n");
+    }
+    if (!testScheduleTypes(engine, engineDesc))
+    {
+        printf("failed testScheduleTypes\n");
+    }
+    if (!testContexts(engine, engineDesc))
+    {
+        printf("failed testContexts\n");
+    }
+    if (!testKeySchedule(engine, engineDesc))
+    {
+        printf("failed testKeySchedule\n");
+    }
+    if (!testSharedKey(engine, engineDesc, clavier, blockType, paddingType))
+    {
+        printf("failed testSharedKey\n");
+    }
+    if (!testCpuEngineInterop(engine, engineDesc, clavier, blockType, paddingType))
+    {
+        printf("failed testCpuEngineInterop\n");
+    }
     if (!testRandomlySizedBlocks(engine, engineDesc, paddingType))
     {
         printf("failed testRandomlySizedBlocks\n");
@@ -778,8 +1299,531 @@ bool doProfiling(void *engine, char *engineDesc, uint32_t size)
     return true;
 }
 
+// a second engine with the same key takes its schedule from the cache, and
+// the cache stays within its budget
+bool testKeyCache()
+{
+    uint8_t clavier[MUM_KEY_SIZE];
+    uint8_t subkeyA[MUM_KEY_SIZE];
+    uint8_t subkeyB[MUM_KEY_SIZE];
+    size_t size;
+    uint32_t numEntries;
+    bool success = true;
+
+    MumSetKeyCacheBudget(64 * 1024 * 1024);
+    fillRandomly(clavier, MUM_KEY_SIZE);
+    for (int blockType = MUM_BLOCKTYPE_128; blockType <= MUM_BLOCKTYPE_4096 && success; blockType++)
+    {
+        void *engineA = MumCreateEngine(MUM_ENGINE_TYPE_CPU, (EMumBlockType)blockType, MUM_PADDING_TYPE_ON, 1);
+        void *engineB = MumCreateEngine(MUM_ENGINE_TYPE_CPU_BITSLICE, (EMumBlockType)blockType, MUM_PADDING_TYPE_ON, 1);
+        MumInitKey(engineA, clavier);
+        MumGetKeyCacheUsage(&size, &numEntries);
+        success = numEntries == (uint32_t)blockType;
+        MumInitKey(engineB, clavier);
+        MumGetKeyCacheUsage(&size, &numEntries);
+        success = success && numEntries == (uint32_t)blockType;
+
+        uint32_t plaintextBlockSize;
+        MumPlaintextBlockSize(engineA, &plaintextBlockSize);
+        uint32_t plaintextSize = plaintextBlockSize * 3 - 7;
+        uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+        uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+        uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+        uint32_t encryptedLen = 0;
+        uint32_t decryptedLen = 0;
+        fillRandomly(plaintext, plaintextSize);
+        MumEncrypt(engineA, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+        EMumError error = MumDecrypt(engineB, encrypt, decrypt, encryptedLen, &decryptedLen);
+        MumGetSubkey(engineA, MUM_NUM_SUBKEYS - 1, subkeyA);
+        MumGetSubkey(engineB, MUM_NUM_SUBKEYS - 1, subkeyB);
+        success = success && error == MUM_ERROR_OK && decryptedLen == plaintextSize &&
+            blockChecker(plaintext, decrypt, plaintextSize) && !memcmp(subkeyA, subkeyB, MUM_KEY_SIZE);
+        if (!success)
+            printf("FAILED testKeyCache, block type %d, entries %u\n", blockType, numEntries);
+        delete[] plaintext;
+        delete[] encrypt;
+        delete[] decrypt;
+        MumDestroyEngine(engineA);
+        MumDestroyEngine(engineB);
+    }
+
+    MumEvictKey(clavier);
+    MumGetKeyCacheUsage(&size, &numEntries);
+    if (size != 0 || numEntries != 0)
+    {
+        printf("FAILED testKeyCache, %u entries after evict\n", numEntries);
+        success = false;
+    }
+
+    // room for one 128-byte schedule only; the other engine keeps the
+    // schedule it attached once that is evicted
+    void *engine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, MUM_BLOCKTYPE_128, MUM_PADDING_TYPE_ON, 1);
+    void *otherEngine = MumCreateEngine(MUM_ENGINE_TYPE_CPU_MT, MUM_BLOCKTYPE_128, MUM_PADDING_TYPE_ON, TEST_MUM_NUM_THREADS);
+    MumInitKey(engine, clavier);
+    MumInitKey(otherEngine, clavier);
+    MumGetKeyCacheUsage(&size, &numEntries);
+    MumSetKeyCacheBudget(size);
+    fillRandomly(clavier, MUM_KEY_SIZE);
+    MumInitKey(engine, clavier);
+    MumGetKeyCacheUsage(&size, &numEntries);
+    if (numEntries != 1)
+    {
+        printf("FAILED testKeyCache, %u entries over budget\n", numEntries);
+        success = false;
+    }
+    uint32_t plaintextSize = 1000;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint32_t encryptedLen = 0;
+    uint32_t decryptedLen = 0;
+    fillRandomly(plaintext, plaintextSize);
+    EMumError error = MumEncrypt(otherEngine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+    if (error == MUM_ERROR_OK)
+        error = MumDecrypt(otherEngine, encrypt, decrypt, encryptedLen, &decryptedLen);
+    if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+    {
+        printf("FAILED testKeyCache, evicted schedule, error %d\n", error);
+        success = false;
+    }
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    MumDestroyEngine(engine);
+    MumDestroyEngine(otherEngine);
+
+    MumSetKeyCacheBudget(0);
+    if (success)
+        printf("SUCCESS testKeyCache\n");
+    return success;
+}
+
+// engines switch between keys of a key store with room for two expansions
+bool testKeyStore()
+{
+    const int numKeys = 3;
+    uint8_t clavier[numKeys][MUM_KEY_SIZE];
+    uint32_t keyId[numKeys];
+    TMumKeyStoreStats stats;
+    EMumError error;
+    bool success = true;
+
+    void *keyStore = MumCreateKeyStore(MUM_BLOCKTYPE_256, 1 << 30);
+    void *engine = MumCreateEngine(MUM_ENGINE_TYPE_CPU_BITSLICE, MUM_BLOCKTYPE_256, MUM_PADDING_TYPE_ON, 1);
+    void *cpuEngine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, MUM_BLOCKTYPE_256, MUM_PADDING_TYPE_ON, 1);
+    uint32_t plaintextBlockSize;
+    MumPlaintextBlockSize(engine, &plaintextBlockSize);
+    uint32_t plaintextSize = plaintextBlockSize * 5 - 9;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+
+    for (int k = 0; k < numKeys; k++)
+    {
+        fillRandomly(clavier[k], MUM_KEY_SIZE);
+        MumKeyStoreAdd(keyStore, clavier[k], &keyId[k]);
+    }
+    MumInitStoreKey(engine, keyStore, keyId[0]);
+    MumGetKeyStoreStats(keyStore, &stats);
+    MumSetKeyStoreBudget(keyStore, 2 * stats.size);
+
+    // key 2 evicts key 0, which then evicts key 2
+    const int order[] = { 0, 1, 2, 2, 1, 0 };
+    for (int k : order)
+    {
+        uint32_t encryptedLen = 0;
+        uint32_t decryptedLen = 0;
+        fillRandomly(plaintext, plaintextSize);
+        error = MumInitStoreKey(engine, keyStore, keyId[k]);
+        if (error == MUM_ERROR_OK)
+            error = MumEncrypt(engine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+        if (error == MUM_ERROR_OK)
+            error = MumInitKey(cpuEngine, clavier[k]);
+        if (error == MUM_ERROR_OK)
+            error = MumDecrypt(cpuEngine, encrypt, decrypt, encryptedLen, &decryptedLen);
+        if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+        {
+            printf("FAILED testKeyStore, key %d, error %d\n", k, error);
+            success = false;
+        }
+    }
+    MumGetKeyStoreStats(keyStore, &stats);
+    if (stats.misses != 4 || stats.hits != 3 || stats.evictions != 2 || stats.numExpanded != 2 || stats.numKeys != numKeys)
+    {
+        printf("FAILED testKeyStore, %llu misses %llu hits %llu evictions %u expanded\n",
+            (unsigned long long)stats.misses, (unsigned long long)stats.hits,
+            (unsigned long long)stats.evictions, stats.numExpanded);
+        success = false;
+    }
+
+    if (MumKeyStoreRemove(keyStore, keyId[1]) != MUM_ERROR_OK ||
+        MumInitStoreKey(engine, keyStore, keyId[1]) != MUM_ERROR_KEYSTORE_KEY_NOT_FOUND ||
+        MumKeyStoreRemove(keyStore, keyId[1]) != MUM_ERROR_KEYSTORE_KEY_NOT_FOUND)
+    {
+        printf("FAILED testKeyStore, removed key found\n");
+        success = false;
+    }
+    void *otherEngine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, MUM_BLOCKTYPE_512, MUM_PADDING_TYPE_ON, 1);
+    if (MumInitStoreKey(otherEngine, keyStore, keyId[0]) != MUM_ERROR_KEYSTORE_BLOCKTYPE)
+    {
+        printf("FAILED testKeyStore, block type not checked\n");
+        success = false;
+    }
+    MumDestroyEngine(otherEngine);
+
+    // the engine, still attached to key 0, keeps its expansion
+    MumSetKeyStoreBudget(keyStore, 0);
+    MumGetKeyStoreStats(keyStore, &stats);
+    if (stats.numExpanded != 0 || stats.size != 0)
+    {
+        printf("FAILED testKeyStore, %u expanded over budget\n", stats.numExpanded);
+        success = false;
+    }
+    uint32_t encryptedLen = 0;
+    uint32_t decryptedLen = 0;
+    error = MumEncrypt(engine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+    if (error == MUM_ERROR_OK)
+        error = MumDecrypt(cpuEngine, encrypt, decrypt, encryptedLen, &decryptedLen);
+    if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+    {
+        printf("FAILED testKeyStore, evicted key, error %d\n", error);
+        success = false;
+    }
+
+    MumDestroyEngine(engine);
+    MumDestroyEngine(cpuEngine);
+    MumDestroyKeyStore(keyStore);
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    if (success)
+        printf("SUCCESS testKeyStore\n");
+    return success;
+}
+
+// the multi-threaded engine changes keys while another thread encrypts with
+// it: every call runs under one of the keys throughout
+bool testHotRekey()
+{
+    const int numEncrypts = 60;
+    const int numRekeys = 30;
+    uint8_t clavier[2][MUM_KEY_SIZE];
+    void *cpuEngine[2];
+    bool success = true;
+
+    void *engine = MumCreateEngine(MUM_ENGINE_TYPE_CPU_MT, MUM_BLOCKTYPE_512, MUM_PADDING_TYPE_ON, TEST_MUM_NUM_THREADS);
+    // code for the retired key is freed only after the swap
+    MumSetKernelMode(engine, MUM_KERNEL_MODE_JIT);
+    for (int k = 0; k < 2; k++)
+    {
+        fillRandomly(clavier[k], MUM_KEY_SIZE);
+        cpuEngine[k] = MumCreateEngine(MUM_ENGINE_TYPE_CPU, MUM_BLOCKTYPE_512, MUM_PADDING_TYPE_ON, 1);
+        MumInitKey(cpuEngine[k], clavier[k]);
+    }
+    MumInitKey(engine, clavier[0]);
+
+    uint32_t plaintextBlockSize;
+    MumPlaintextBlockSize(engine, &plaintextBlockSize);
+    uint32_t plaintextSize = plaintextBlockSize * 100 - 11;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+
+    std::thread encryptor([&]() {
+        for (int i = 0; i < numEncrypts; i++)
+        {
+            uint32_t encryptedLen = 0;
+            fillRandomly(plaintext, plaintextSize);
+            MumEncrypt(engine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+            bool decrypted = false;
+            for (int k = 0; k < 2 && !decrypted; k++)
+            {
+                uint32_t decryptedLen = 0;
+                EMumError error = MumDecrypt(cpuEngine[k], encrypt, decrypt, encryptedLen, &decryptedLen);
+                decrypted = error == MUM_ERROR_OK && decryptedLen == plaintextSize && blockChecker(plaintext, decrypt, plaintextSize);
+            }
+            if (!decrypted)
+            {
+                printf("FAILED testHotRekey, encryption %d under neither key\n", i);
+                success = false;
+            }
+        }
+    });
+    // key changes from two threads take turns
+    std::thread rekeyer([&]() {
+        for (int i = 0; i < numRekeys; i++)
+            MumInitKey(engine, clavier[i & 1]);
+    });
+    for (int i = 1; i <= numRekeys; i++)
+        MumInitKey(engine, clavier[i & 1]);
+    rekeyer.join();
+    encryptor.join();
+    MumInitKey(engine, clavier[0]);
+
+    uint32_t encryptedLen = 0;
+    uint32_t decryptedLen = 0;
+    fillRandomly(plaintext, plaintextSize);
+    MumEncrypt(engine, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+    EMumError error = MumDecrypt(cpuEngine[0], encrypt, decrypt, encryptedLen, &decryptedLen);
+    if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+    {
+        printf("FAILED testHotRekey, last key, error %d\n", error);
+        success = false;
+    }
+
+    MumDestroyEngine(engine);
+    MumDestroyEngine(cpuEngine[0]);
+    MumDestroyEngine(cpuEngine[1]);
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    if (success)
+        printf("SUCCESS testHotRekey\n");
+    return success;
+}
+
+// allocations from huge pages and from the heap are aligned, hold what is
+// written and free; position tables from either decrypt the same
+bool testHugePages()
+{
+    const size_t sizes[] = { 4096, MUM_HUGE_PAGE_SIZE, 3 * MUM_HUGE_PAGE_SIZE + 100 };
+    uint8_t clavier[MUM_KEY_SIZE];
+    void *engine[2];
+    bool success = true;
+
+    for (uint32_t enable = 0; enable < 2; enable++)
+    {
+        MumSetHugePages(enable);
+        for (size_t size : sizes)
+        {
+            uint8_t *heap = (uint8_t *)MumAlloc(size);
+            uint8_t *pages = (uint8_t *)MumAllocHugePages(size);
+            if (heap == nullptr || pages == nullptr || (uintptr_t)heap % MUM_ALLOC_ALIGNMENT != 0 || (uintptr_t)pages % MUM_ALLOC_ALIGNMENT != 0)
+            {
+                printf("FAILED testHugePages, allocation of %zu, huge pages %u\n", size, enable);
+                success = false;
+                MumFree(heap);
+                MumFree(pages);
+                continue;
+            }
+#ifdef USE_HUGEPAGES
+            // mapped on a huge page boundary
+            if (enable && size >= MUM_HUGE_PAGE_SIZE && (uintptr_t)pages % MUM_HUGE_PAGE_SIZE != 0)
+            {
+                printf("FAILED testHugePages, %zu not from huge pages\n", size);
+                success = false;
+            }
+#endif
+            memset(heap, 0x5a, size);
+            memset(pages, 0xa5, size);
+            if (heap[size - 1] != 0x5a || pages[0] != 0xa5 || pages[size - 1] != 0xa5)
+            {
+                printf("FAILED testHugePages, contents of %zu, huge pages %u\n", size, enable);
+                success = false;
+            }
+            MumFree(heap);
+            MumFree(pages);
+        }
+    }
+
+    // 512-byte blocks take 2MB of position tables
+    fillRandomly(clavier, MUM_KEY_SIZE);
+    for (uint32_t enable = 0; enable < 2; enable++)
+    {
+        MumSetHugePages(enable);
+        engine[enable] = MumCreateEngine(MUM_ENGINE_TYPE_CPU, MUM_BLOCKTYPE_512, MUM_PADDING_TYPE_ON, 1);
+        MumSetScheduleType(engine[enable], MUM_SCHEDULE_TYPE_POSITION_TABLES);
+        MumInitKey(engine[enable], clavier);
+    }
+    MumSetHugePages(0);
+
+    uint32_t plaintextSize = 10 * MUM_MAX_BLOCK_SIZE - 3;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    for (uint32_t e = 0; e < 2; e++)
+    {
+        uint32_t encryptedLen = 0;
+        uint32_t decryptedLen = 0;
+        fillRandomly(plaintext, plaintextSize);
+        MumEncrypt(engine[e], plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+        EMumError error = MumDecrypt(engine[1 - e], encrypt, decrypt, encryptedLen, &decryptedLen);
+        if (error != MUM_ERROR_OK || decryptedLen != plaintextSize || !blockChecker(plaintext, decrypt, plaintextSize))
+        {
+            printf("FAILED testHugePages, engine %u, error %d\n", e, error);
+            success = false;
+        }
+    }
+
+    MumDestroyEngine(engine[0]);
+    MumDestroyEngine(engine[1]);
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    if (success)
+        printf("SUCCESS testHugePages\n");
+    return success;
+}
+
+// a CPU-MT engine encrypts with another block type while its key changes;
+// each encryption decrypts under one of the keys
+bool testBlockTypeRekey()
+{
+    const int numEncrypts = 40;
+    const int numRekeys = 20;
+    uint8_t clavier[2][MUM_KEY_SIZE];
+    void *cpuEngine[2];
+    bool success = true;
+
+    void *engine = MumCreateEngine(MUM_ENGINE_TYPE_CPU_MT, MUM_BLOCKTYPE_512, MUM_PADDING_TYPE_ON, TEST_MUM_NUM_THREADS);
+    for (int k = 0; k < 2; k++)
+    {
+        fillRandomly(clavier[k], MUM_KEY_SIZE);
+        cpuEngine[k] = MumCreateEngine(MUM_ENGINE_TYPE_CPU, MUM_BLOCKTYPE_1024, MUM_PADDING_TYPE_ON, 1);
+        MumInitKey(cpuEngine[k], clavier[k]);
+    }
+    MumInitKey(engine, clavier[0]);
+
+    uint32_t plaintextSize = 20 * MUM_MAX_BLOCK_SIZE - 5;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 5 / 4 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+
+    std::thread encryptor([&]() {
+        for (int i = 0; i < numEncrypts; i++)
+        {
+            uint32_t encryptedLen = 0;
+            fillRandomly(plaintext, plaintextSize);
+            MumEncryptWithBlockType(engine, MUM_BLOCKTYPE_1024, plaintext, encrypt, plaintextSize, &encryptedLen, 0);
+            bool decrypted = false;
+            for (int k = 0; k < 2 && !decrypted; k++)
+            {
+                uint32_t decryptedLen = 0;
+                EMumError error = MumDecrypt(cpuEngine[k], encrypt, decrypt, encryptedLen, &decryptedLen);
+                decrypted = error == MUM_ERROR_OK && decryptedLen == plaintextSize && blockChecker(plaintext, decrypt, plaintextSize);
+            }
+            if (!decrypted)
+            {
+                printf("FAILED testBlockTypeRekey, encryption %d under neither key\n", i);
+                success = false;
+            }
+        }
+    });
+    for (int i = 1; i <= numRekeys; i++)
+        MumInitKey(engine, clavier[i & 1]);
+    encryptor.join();
+
+    MumDestroyEngine(engine);
+    MumDestroyEngine(cpuEngine[0]);
+    MumDestroyEngine(cpuEngine[1]);
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    if (success)
+        printf("SUCCESS testBlockTypeRekey\n");
+    return success;
+}
+
+// one engine encrypts with every block type; engines of those block types
+// decrypt, and the engine finds the block type to decrypt
+bool testBlockTypes(EMumEngineType engineType, EMumPaddingType paddingType)
+{
+    uint8_t clavier[MUM_KEY_SIZE];
+    bool success = true;
+
+    fillRandomly(clavier, MUM_KEY_SIZE);
+    void *engine = MumCreateEngine(engineType, MUM_BLOCKTYPE_512, paddingType, TEST_MUM_NUM_THREADS);
+    MumInitKey(engine, clavier);
+    uint32_t plaintextSize = 3 * MUM_MAX_BLOCK_SIZE - 17;
+    uint8_t *plaintext = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+    uint8_t *encrypt = new uint8_t[plaintextSize * 2 + MUM_MAX_BLOCK_SIZE];
+    uint8_t *decrypt = new uint8_t[plaintextSize + MUM_MAX_BLOCK_SIZE];
+
+    for (int blockType = MUM_BLOCKTYPE_128; blockType <= MUM_BLOCKTYPE_4096; blockType++)
+    {
+        void *cpuEngine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, (EMumBlockType)blockType, paddingType, 1);
+        MumInitKey(cpuEngine, clavier);
+        uint32_t plaintextBlockSize;
+        MumPlaintextBlockSize(cpuEngine, &plaintextBlockSize);
+        // whole blocks without padding
+        uint32_t size = paddingType == MUM_PADDING_TYPE_ON ? plaintextSize : plaintextSize / plaintextBlockSize * plaintextBlockSize;
+        uint32_t encryptedLen = 0;
+        uint32_t decryptedLen = 0;
+        fillRandomly(plaintext, size);
+        EMumError error = MumEncryptWithBlockType(engine, (EMumBlockType)blockType, plaintext, encrypt, size, &encryptedLen, 0);
+        if (error == MUM_ERROR_OK)
+            error = MumDecrypt(cpuEngine, encrypt, decrypt, encryptedLen, &decryptedLen);
+        if (error != MUM_ERROR_OK || decryptedLen != size || !blockChecker(plaintext, decrypt, size))
+        {
+            printf("FAILED testBlockTypes, engine %d, block type %d, error %d\n", engineType, blockType, error);
+            success = false;
+        }
+
+        // the block type bits are padding
+        EMumBlockType foundType = paddingType == MUM_PADDING_TYPE_ON ? MUM_BLOCKTYPE_INVALID : (EMumBlockType)blockType;
+        decryptedLen = 0;
+        memset(decrypt, 0, size);
+        error = MumDecryptWithBlockType(engine, &foundType, encrypt, decrypt, encryptedLen, &decryptedLen);
+        if (error != MUM_ERROR_OK || foundType != blockType || decryptedLen != size || !blockChecker(plaintext, decrypt, size))
+        {
+            printf("FAILED testBlockTypes, engine %d, block type %d found %d, error %d\n", engineType, blockType, foundType, error);
+            success = false;
+        }
+        MumDestroyEngine(cpuEngine);
+    }
+
+    delete[] plaintext;
+    delete[] encrypt;
+    delete[] decrypt;
+    MumDestroyEngine(engine);
+    if (success)
+        printf("SUCCESS testBlockTypes, engine %d, padding %d\n", engineType, paddingType);
+    return success;
+}
+
 bool doTests()
 {
+    if (!testStaleSharedKey())
+    {
+        printf("failed testStaleSharedKey\n");
+    }
+    if (!testContextStreams())
+    {
+        printf("failed testContextStreams\n");
+    }
+    if (!testKeyCache())
+    {
+        printf("failed testKeyCache\n");
+    }
+    if (!testKeyStore())
+    {
+        printf("failed testKeyStore\n");
+    }
+    if (!testHotRekey())
+    {
+        printf("failed testHotRekey\n");
+    }
+    if (!testBlockTypeRekey())
+    {
+        printf("failed testBlockTypeRekey\n");
+    }
+    if (!testHugePages())
+    {
+        printf("failed testHugePages\n");
+    }
+    for (int engineIndex = 0; engineIndex < TEST_NUM_ENGINES; engineIndex++)
+    {
+        // only runs 4096-byte blocks
+        if (engineList[engineIndex] == MUM_ENGINE_TYPE_GPU_B)
+            continue;
+        for (int paddingIndex = 0; paddingIndex < TEST_NUM_PADDING_TYPES; paddingIndex++)
+        {
+            if (!testBlockTypes(engineList[engineIndex], paddingList[paddingIndex]))
+            {
+                printf("failed testBlockTypes\n");
+            }
+        }
+    }
     for (int paddingIndex = 0; paddingIndex < TEST_NUM_PADDING_TYPES; paddingIndex++)
     {
         for (int engineIndex = 0; engineIndex < TEST_NUM_ENGINES; engineIndex++)
@@ -800,8 +1844,33 @@ bool doTests()
     return true;
 }
 
+// key setup time of the CPU engine for each block type, the key cache off
+void profileKeySetup()
+{
+    const int numKeys = 8;
+    uint8_t clavier[MUM_KEY_SIZE];
+
+    for (int blockType = MUM_BLOCKTYPE_128; blockType <= MUM_BLOCKTYPE_4096; blockType++)
+    {
+        void *engine = MumCreateEngine(MUM_ENGINE_TYPE_CPU, (EMumBlockType)blockType, MUM_PADDING_TYPE_ON, 1);
+        uint32_t encryptedBlockSize;
+        MumEncryptedBlockSize(engine, &encryptedBlockSize);
+        double keyTime = 0.0;
+        for (int k = 0; k < numKeys; k++)
+        {
+            fillRandomly(clavier, MUM_KEY_SIZE);
+            auto t = utilGetTime();
+            MumInitKey(engine, clavier);
+            keyTime += utilGetTime() - t;
+        }
+        printf("profileKeySetup: blocksize %u, key setup time %f msec\n", encryptedBlockSize, 1000.0 * keyTime / numKeys);
+        MumDestroyEngine(engine);
+    }
+}
+
 bool doProfilings()
 {
+    profileKeySetup();
     for (int engineIndex = 0; engineIndex < TEST_NUM_ENGINES; engineIndex++)
     {
         for (int paddingIndex = 0; paddingIndex < TEST_NUM_PADDING_TYPES; paddingIndex++)